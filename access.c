@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+#include "access.h"
+
+void access_model_init(access_model_t *model) {
+    model->kind = ACCESS_NONE;
+    model->rate = ACCESS_RATE;
+    model->hot_pages = ACCESS_HOT_PAGES;
+    model->hot_percent = ACCESS_HOT_PERCENT;
+    model->phase = ACCESS_PHASE;
+    model->seed = 1;
+    model->trace = NULL;
+}
+
+// "loc[:<hot pages>[:<hot percent>[:<phase>[:<seed>]]]]" picks the locality
+// model, anything else names an access trace for the caller to load.
+// Returns -1 for a malformed locality spec.
+int parse_access_model(const char *spec, access_model_t *model) {
+    if (strncmp(spec, "loc", 3) != 0 || (spec[3] != '\0' && spec[3] != ':')) {
+        model->kind = ACCESS_TRACE;
+        return 0;
+    }
+    long values[4] = { model->hot_pages, model->hot_percent, model->phase, (long)model->seed };
+    const char *p = spec + 3;
+    for (int i = 0; i < 4 && *p == ':'; i++) {
+        char *end;
+        values[i] = strtol(p + 1, &end, 10);
+        if (end == p + 1) return -1;
+        p = end;
+    }
+    if (*p != '\0' || values[0] < 1 || values[0] > 1 << 30 || values[1] < 0 || values[1] > 100 ||
+            values[2] < 1 || values[2] > 1 << 30 || values[3] < 0) {
+        return -1;
+    }
+    model->kind = ACCESS_LOCALITY;
+    model->hot_pages = (int)values[0];
+    model->hot_percent = (int)values[1];
+    model->phase = (int)values[2];
+    model->seed = (uint64_t)values[3];
+    return 0;
+}
+
+// xorshift64*: one short dependency chain per draw, so generating accesses
+// costs far less than replaying them
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dull;
+}
+
+// Uniform in [0, n) from 32 random bits, without a divide
+static int below(uint32_t bits, int n) {
+    return (int)(((uint64_t)bits * (uint32_t)n) >> 32);
+}
+
+// seq is the process's arrival order, which tells processes with the same name apart
+void access_start(const access_model_t *model, access_state_t *state, long seq) {
+    // splitmix64 of the seed and seq spreads nearby seeds apart; the state must not be 0
+    uint64_t z = model->seed + (uint64_t)(seq + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    state->rng = z ? z : 1;
+    state->pos = 0;
+    state->hot_base = 0;
+    state->phase_left = 0;
+}
+
+// Fills out with up to max of the process's next accesses, as pages below
+// pages, and returns how many there were. A process's trace list is replayed
+// from the start again once it runs out, and pages past the end of the
+// process wrap around; a process the trace does not name touches nothing.
+int next_accesses(const access_model_t *model, access_state_t *state, const char *pid, int pages, int *out, int max) {
+    if (pages <= 0) return 0;
+    if (model->kind == ACCESS_TRACE) {
+        const access_list_t *list = find_access_list(model->trace, pid);
+        if (list == NULL || list->count == 0) return 0;
+        const int *trace_pages = model->trace->pages + list->start;
+        long pos = state->pos;
+        for (int i = 0; i < max; i++) {
+            int page = trace_pages[pos];
+            out[i] = page < pages ? page : page % pages;
+            if (++pos == list->count) pos = 0;
+        }
+        state->pos = pos;
+        return max;
+    }
+
+    // The state lives in locals for the loop so stores to out cannot force it back to memory
+    int hot = model->hot_pages < pages ? model->hot_pages : pages;
+    uint64_t hot_threshold = ((uint64_t)model->hot_percent << 32) / 100;
+    uint64_t rng = state->rng;
+    int hot_base = state->hot_base;
+    int phase_left = state->phase_left;
+    for (int i = 0; i < max; i++) {
+        if (phase_left == 0) {
+            hot_base = below((uint32_t)next_random(&rng), pages);
+            phase_left = model->phase;
+        }
+        phase_left--;
+        // Both candidates are worked out and masked, so an unpredictable
+        // choice between them costs no branch mispredictions
+        uint64_t r = next_random(&rng);
+        int near = hot_base + below((uint32_t)(r >> 32), hot);
+        near -= near >= pages ? pages : 0;
+        int far = below((uint32_t)(r >> 32), pages);
+        int take_near = -(int)((uint32_t)r < hot_threshold);
+        out[i] = (near & take_near) | (far & ~take_near);
+    }
+    state->rng = rng;
+    state->hot_base = hot_base;
+    state->phase_left = phase_left;
+    return max;
+}
@@ -0,0 +1,43 @@
+#ifndef ACCESS_H
+#define ACCESS_H
+
+#include <stdint.h>
+#include "trace.h"
+
+// Where the pages a process touches come from when virtual pages on demand
+typedef enum { ACCESS_NONE, ACCESS_LOCALITY, ACCESS_TRACE } access_kind_t;
+
+#define ACCESS_RATE 100  // default memory accesses per simulated second of CPU
+#define ACCESS_BATCH 256  // accesses generated and replayed at a time
+#define ACCESS_HOT_PAGES 16  // locality model defaults
+#define ACCESS_HOT_PERCENT 90
+#define ACCESS_PHASE 1000
+
+// The locality model sends each access to a window of hot_pages pages with
+// probability hot_percent and anywhere in the process otherwise; the window
+// jumps to a random page every phase accesses. Each process draws from its
+// own generator seeded from seed and its arrival order.
+typedef struct {
+    access_kind_t kind;
+    int rate;
+    int hot_pages;
+    int hot_percent;
+    int phase;
+    uint64_t seed;
+    const access_trace_t *trace;  // ACCESS_TRACE: shared between runs, never modified
+} access_model_t;
+
+// How far one process has got through its accesses
+typedef struct {
+    uint64_t rng;
+    long pos;  // ACCESS_TRACE: next entry of its access list
+    int hot_base;  // first page of the hot window
+    int phase_left;  // accesses until the window moves
+} access_state_t;
+
+void access_model_init(access_model_t *model);
+int parse_access_model(const char *spec, access_model_t *model);
+void access_start(const access_model_t *model, access_state_t *state, long seq);
+int next_accesses(const access_model_t *model, access_state_t *state, const char *pid, int pages, int *out, int max);
+
+#endif // ACCESS_H
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "memory_management.h"
+
+// Benchmark harness: generates a seeded synthetic trace, then times trace
+// loading, the scheduler and the allocator of every -m strategy.
+
+#define MAX_STRATEGIES 16
+#define LIVE_MAX 64  // processes the allocator replay keeps resident at most
+
+typedef enum { DIST_FIXED, DIST_UNIFORM, DIST_EXP, DIST_PARETO } dist_kind_t;
+
+// "fixed:V", "uniform:LO:HI", "exp:MEAN" or "pareto:MIN:ALPHA"
+typedef struct {
+    dist_kind_t kind;
+    double a, b;
+} dist_t;
+
+typedef struct {
+    long processes;
+    uint64_t seed;
+    dist_t arrival;  // gap between consecutive arrivals
+    dist_t memory;  // KB, clamped to [1, max_memory]
+    dist_t runtime;  // seconds, at least 1
+    int max_memory;  // the simulated memory size in KB
+} workload_t;
+
+static uint64_t rng_state;
+
+// splitmix64, so a seed always gives the same trace
+static uint64_t next_random(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// uniform in (0, 1]
+static double next_unit(void) {
+    return ((next_random() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static double sample(const dist_t *d) {
+    switch (d->kind) {
+    case DIST_FIXED:
+        return d->a;
+    case DIST_UNIFORM:
+        return d->a + floor(next_unit() * (d->b - d->a + 1));
+    case DIST_EXP:
+        return -d->a * log(next_unit());
+    case DIST_PARETO:
+        return d->a / pow(next_unit(), 1.0 / d->b);
+    }
+    return d->a;
+}
+
+static int clamp(double v, int lo, int hi) {
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return (int)v;
+}
+
+static int parse_dist(const char *spec, dist_t *d) {
+    char kind[16];
+    d->a = d->b = 0;
+    int n = sscanf(spec, "%15[a-z]:%lf:%lf", kind, &d->a, &d->b);
+    if (n >= 2 && strcmp(kind, "fixed") == 0) {
+        d->kind = DIST_FIXED;
+    } else if (n == 3 && strcmp(kind, "uniform") == 0 && d->b >= d->a) {
+        d->kind = DIST_UNIFORM;
+    } else if (n >= 2 && strcmp(kind, "exp") == 0 && d->a > 0) {
+        d->kind = DIST_EXP;
+    } else if (n == 3 && strcmp(kind, "pareto") == 0 && d->a > 0 && d->b > 0) {
+        d->kind = DIST_PARETO;
+    } else {
+        fprintf(stderr, "Invalid distribution %s\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+// Write the workload as a text trace, the format read_input has always taken
+static int write_workload(const workload_t *w, const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open file %s\n", filename);
+        return -1;
+    }
+    rng_state = w->seed;
+    double arrival = 0;
+    for (long i = 0; i < w->processes; i++) {
+        arrival += sample(&w->arrival);
+        fprintf(fp, "%d P%ld %d %d\n", clamp(arrival, 0, INT32_MAX), i,
+            clamp(sample(&w->runtime), 1, INT32_MAX), clamp(sample(&w->memory), 1, w->max_memory));
+    }
+    return fclose(fp);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static int try_allocate(sim_t *sim, node_t *node, char *strategy, int time) {
+    if (is_contiguous_strategy(strategy)) {
+        node->addr = contiguous_allocate(sim, node, strategy);
+        return node->addr != -1;
+    }
+    EvictResult result = strcmp(strategy, "paged") == 0 ? allocate_pages(sim, node, time)
+                                                       : allocate_virtual_pages(sim, node, time);
+    return result.success;
+}
+
+static void release(sim_t *sim, node_t *node, char *strategy) {
+    if (is_contiguous_strategy(strategy)) {
+        deallocate(sim, node, strategy);
+    } else {
+        release_frames(sim, node);
+    }
+    release_node(sim, node);
+}
+
+// Replay the trace straight against the allocator: every process is
+// allocated, and the oldest resident ones are freed to keep at most LIVE_MAX
+// resident or to make room. Returns the elapsed ns; *calls counts allocations.
+static double replay_allocator(sim_t *sim, const trace_t *trace, char *strategy, long *calls) {
+    node_t *live[LIVE_MAX];
+    int head = 0, count = 0;
+    *calls = 0;
+
+    double start = now_ns();
+    for (long i = 0; i < trace->count; i++) {
+        const process_record_t *r = &trace->records[i];
+        node_t *node = create_node(sim, r->pid, r->arr_time, r->run_time, r->memory);
+        int ok;
+        for (;;) {
+            ok = try_allocate(sim, node, strategy, (int)i);
+            (*calls)++;
+            if (ok || count == 0) break;
+            release(sim, live[head], strategy);
+            head = (head + 1) % LIVE_MAX;
+            count--;
+        }
+        if (!ok) {
+            release(sim, node, strategy);
+            continue;
+        }
+        if (count == LIVE_MAX) {
+            release(sim, live[head], strategy);
+            head = (head + 1) % LIVE_MAX;
+            count--;
+        }
+        live[(head + count++) % LIVE_MAX] = node;
+    }
+    while (count > 0) {
+        release(sim, live[head], strategy);
+        head = (head + 1) % LIVE_MAX;
+        count--;
+    }
+    return now_ns() - start;
+}
+
+// Time one strategy, best of repeats, and print its row. Runs in a child of
+// its own so one strategy's peak RSS never carries over into the next row.
+static void bench_strategy(const trace_t *trace, const sim_config_t *config, char *strategy, int quantum, int repeats) {
+    double sched_ns = 0, alloc_ns = 0;
+    long quanta = 0, scheduler_allocs = 0, calls = 0;
+
+    for (int rep = 0; rep < repeats; rep++) {
+        sim_t *sim = malloc(sizeof(sim_t));
+        if (!sim) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        sim_init(sim, config, OUTPUT_DISCARD);
+        sim->trace = trace;
+        double start = now_ns();
+        run_simulation(sim, quantum, strategy);
+        double elapsed = now_ns() - start;
+        if (rep == 0 || elapsed < sched_ns) sched_ns = elapsed;
+        quanta = sim->quanta;
+        scheduler_allocs = sim->allocations;
+        sim_destroy(sim);
+
+        if (strcmp(strategy, "infinite") != 0) {
+            sim_init(sim, config, OUTPUT_DISCARD);
+            elapsed = replay_allocator(sim, trace, strategy, &calls);
+            if (rep == 0 || elapsed < alloc_ns) alloc_ns = elapsed;
+            sim_destroy(sim);
+        }
+        free(sim);
+    }
+
+    printf("%-10s %12.3f %12ld %12.1f %12ld", strategy, sched_ns / 1e6, quanta,
+        quanta ? sched_ns / quanta : 0.0, scheduler_allocs);
+    if (strcmp(strategy, "infinite") == 0) {
+        printf(" %12s %12s", "-", "-");
+    } else {
+        printf(" %12ld %12.1f", calls, calls ? alloc_ns / calls : 0.0);
+    }
+    printf(" %12ld\n", peak_rss_kb());
+}
+
+// Writes strategy's event log and summary to a temporary file, fast-forwarding
+// or not; returns the open file rewound, or NULL
+static FILE* logged_run(const trace_t *trace, const sim_config_t *config, char *strategy, int quantum, int fast_forward) {
+    FILE *fp = tmpfile();
+    sim_t *sim = malloc(sizeof(sim_t));
+    if (!fp || !sim) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    sim_init(sim, config, fileno(fp));
+    sim->trace = trace;
+    sim->fast_forward = fast_forward;
+    run_simulation(sim, quantum, strategy);
+    write_summary(&sim->out, &sim->summary);
+    int status = output_flush(&sim->out);
+    sim_destroy(sim);
+    free(sim);
+    if (status != 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// Fast-forwarding must not change a run: checks that strategy gives the
+// same log with and without it, and prints the first line that differs
+static int verify_strategy(const trace_t *trace, const sim_config_t *config, char *strategy, int quantum) {
+    FILE *skipped = logged_run(trace, config, strategy, quantum, 1);
+    FILE *stepped = logged_run(trace, config, strategy, quantum, 0);
+    int status = skipped && stepped ? 0 : -1;
+    char a[4096], b[4096];
+    long line = 0;
+    while (status == 0) {
+        char *got_a = fgets(a, sizeof(a), skipped);
+        char *got_b = fgets(b, sizeof(b), stepped);
+        line++;
+        if (!got_a && !got_b) break;
+        if (!got_a || !got_b || strcmp(a, b) != 0) {
+            printf("%-10s differs at line %ld:\n  fast-forward: %s  every quantum: %s", strategy, line,
+                got_a ? a : "(end)\n", got_b ? b : "(end)\n");
+            status = -1;
+        }
+    }
+    if (status == 0) {
+        printf("%-10s same %ld lines\n", strategy, line - 1);
+    }
+    if (skipped) fclose(skipped);
+    if (stepped) fclose(stepped);
+    return status;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: bench [-n processes] [-x seed] [-I arrival] [-K memory] [-L runtime]\n"
+        "             [-q quantum] [-m strategy,...] [-i repeats] [-M memory] [-P page size]\n"
+        "             [-c cpus] [-r policy] [-s scheduler] [-g trace file] [-V]\n"
+        "-I, -K and -L draw arrival gaps, process sizes (KB) and run times;\n"
+        "-q, -m, -M, -P, -c, -r and -s mean what they do for allocate\n"
+        "-V checks every strategy logs the same with and without fast-forwarding\n"
+        "distributions: fixed:V uniform:LO:HI exp:MEAN pareto:MIN:ALPHA\n");
+}
+
+int main(int argc, char **argv) {
+    workload_t w = { 10000, 1, { DIST_EXP, 60, 0 }, { DIST_UNIFORM, 16, 256 }, { DIST_UNIFORM, 1, 100 }, MAX_MEMORY };
+    int page_size = PAGE_SIZE;
+    int cpus = 1;
+    int quantum = 3;
+    int repeats = 3;
+    char *strategy_arg = NULL;
+    char *generate_only = NULL;
+    replacement_policy_t policy = POLICY_LRU;
+    scheduler_t scheduler = SCHEDULER_RR;
+    int verify = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:x:I:K:L:q:m:i:g:M:P:c:r:s:V")) != -1) {
+        switch (opt) {
+        case 'n': w.processes = atol(optarg); break;
+        case 'x': w.seed = strtoull(optarg, NULL, 10); break;
+        case 'I': if (parse_dist(optarg, &w.arrival) != 0) return 1; break;
+        case 'K': if (parse_dist(optarg, &w.memory) != 0) return 1; break;
+        case 'L': if (parse_dist(optarg, &w.runtime) != 0) return 1; break;
+        case 'q': quantum = atoi(optarg); break;
+        case 'm': strategy_arg = optarg; break;
+        case 'i': repeats = atoi(optarg); break;
+        case 'g': generate_only = optarg; break;
+        case 'M': w.max_memory = parse_size_kb(optarg); break;
+        case 'P': page_size = parse_size_kb(optarg); break;
+        case 'c': cpus = atoi(optarg); break;
+        case 'r': if (parse_policy(optarg, &policy) != 0) { usage(); return 1; } break;
+        case 's': if (parse_scheduler(optarg, &scheduler) != 0) { usage(); return 1; } break;
+        case 'V': verify = 1; break;
+        default: usage(); return 1;
+        }
+    }
+    if (w.processes <= 0 || w.processes > 9999999 || quantum <= 0 || repeats <= 0 || cpus < 1 || cpus > MAX_CPUS) {
+        usage();
+        return 1;
+    }
+
+    sim_config_t config;
+    if (init_config(&config, w.max_memory, page_size, MIN_PAGES) != 0) {
+        fprintf(stderr, "Invalid memory geometry\n");
+        return 1;
+    }
+    config.cpus = cpus;
+    config.policy = policy;
+    config.scheduler = scheduler;
+
+    if (generate_only != NULL) {
+        return write_workload(&w, generate_only) == 0 ? 0 : 1;
+    }
+
+    char default_strategies[] = "infinite,first_fit,best_fit,next_fit,buddy,paged,virtual";
+    char *strategies[MAX_STRATEGIES];
+    int num_strategies = 0;
+    for (char *s = strtok(strategy_arg ? strategy_arg : default_strategies, ",");
+         s != NULL && num_strategies < MAX_STRATEGIES; s = strtok(NULL, ",")) {
+        if (!is_valid_strategy(s)) {
+            fprintf(stderr, "Unsupported memory strategy\n");
+            return 1;
+        }
+        strategies[num_strategies++] = s;
+    }
+
+    char filename[] = "/tmp/bench-trace-XXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open file %s\n", filename);
+        return 1;
+    }
+    close(fd);
+    if (write_workload(&w, filename) != 0) {
+        unlink(filename);
+        return 1;
+    }
+
+    // read_input is a load_trace followed by node creation as processes arrive
+    trace_t trace;
+    double load_ns = 0;
+    for (int rep = 0; rep < repeats; rep++) {
+        if (rep > 0) free_trace(&trace);
+        double start = now_ns();
+        if (load_trace(&trace, filename) != 0) {
+            unlink(filename);
+            return 1;
+        }
+        double elapsed = now_ns() - start;
+        if (rep == 0 || elapsed < load_ns) load_ns = elapsed;
+    }
+    unlink(filename);
+
+    if (verify) {
+        int failed = 0;
+        for (int i = 0; i < num_strategies; i++) {
+            failed |= verify_strategy(&trace, &config, strategies[i], quantum) != 0;
+        }
+        free_trace(&trace);
+        return failed;
+    }
+
+    printf("seed=%llu processes=%ld quantum=%d repeats=%d memory=%dKB page=%dKB cpus=%d\n",
+        (unsigned long long)w.seed, w.processes, quantum, repeats, config.memory_kb, config.page_size, config.cpus);
+    printf("read_input %12.3f ms %12.1f ns/record\n", load_ns / 1e6, load_ns / trace.count);
+    printf("%-10s %12s %12s %12s %12s %12s %12s %12s\n", "strategy", "sched_ms", "quanta",
+        "ns/quantum", "sched_allocs", "allocs", "ns/alloc", "peak_rss_kb");
+    fflush(stdout);
+
+    for (int i = 0; i < num_strategies; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            bench_strategy(&trace, &config, strategies[i], quantum, repeats);
+            fflush(stdout);
+            _exit(0);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Benchmark of %s failed\n", strategies[i]);
+        }
+    }
+
+    free_trace(&trace);
+    return 0;
+}
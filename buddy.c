@@ -0,0 +1,145 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "buddy.h"
+
+static int is_free(const buddy_t *buddy, int start, int order) {
+    int i = start >> order;
+    return (buddy->free_bits[order][i >> 6] >> (i & 63)) & 1;
+}
+
+static void push_block(buddy_t *buddy, int start, int order) {
+    int head = buddy->heads[order];
+    buddy->next[start] = head;
+    buddy->prev[start] = -1;
+    if (head != -1) {
+        buddy->prev[head] = start;
+    }
+    buddy->heads[order] = start;
+    buddy->order_mask |= 1u << order;
+    int i = start >> order;
+    buddy->free_bits[order][i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+static void unlink_block(buddy_t *buddy, int start, int order) {
+    int next = buddy->next[start], prev = buddy->prev[start];
+    if (prev != -1) {
+        buddy->next[prev] = next;
+    } else {
+        buddy->heads[order] = next;
+    }
+    if (next != -1) {
+        buddy->prev[next] = prev;
+    }
+    if (buddy->heads[order] == -1) {
+        buddy->order_mask &= ~(1u << order);
+    }
+    int i = start >> order;
+    buddy->free_bits[order][i >> 6] &= ~((uint64_t)1 << (i & 63));
+}
+
+// Everything starts free, carved into the largest aligned blocks that fit
+void buddy_init(buddy_t *buddy, int units) {
+    buddy->units = units;
+    buddy->orders = 0;
+    while (buddy->orders < BUDDY_MAX_ORDERS - 1 && (1L << buddy->orders) <= units) {
+        buddy->orders++;
+    }
+    buddy->order_mask = 0;
+    buddy->used_units = 0;
+    buddy->next = malloc(units * sizeof(int));
+    buddy->prev = malloc(units * sizeof(int));
+    long words = 0;
+    for (int k = 0; k < buddy->orders; k++) {
+        words += ((units >> k) + 63) / 64;
+    }
+    buddy->bits = calloc(words, sizeof(uint64_t));
+    if (!buddy->next || !buddy->prev || !buddy->bits) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    words = 0;
+    for (int k = 0; k < BUDDY_MAX_ORDERS; k++) {
+        buddy->heads[k] = -1;
+        buddy->free_bits[k] = k < buddy->orders ? buddy->bits + words : NULL;
+        if (k < buddy->orders) {
+            words += ((units >> k) + 63) / 64;
+        }
+    }
+
+    // Push the highest addresses first so allocation starts at the bottom
+    int starts[BUDDY_MAX_ORDERS], orders[BUDDY_MAX_ORDERS], blocks = 0;
+    for (long start = 0; start < units; ) {
+        int order = start ? __builtin_ctzl(start) : buddy->orders - 1;
+        while (order >= buddy->orders || start + (1L << order) > units) {
+            order--;
+        }
+        starts[blocks] = (int)start;
+        orders[blocks++] = order;
+        start += 1L << order;
+    }
+    while (blocks > 0) {
+        blocks--;
+        push_block(buddy, starts[blocks], orders[blocks]);
+    }
+}
+
+void buddy_destroy(buddy_t *buddy) {
+    free(buddy->next);
+    free(buddy->prev);
+    free(buddy->bits);
+    buddy->next = buddy->prev = NULL;
+    buddy->bits = NULL;
+    buddy->units = 0;
+}
+
+// Smallest order whose blocks hold units
+int buddy_order(int units) {
+    return units <= 1 ? 0 : 32 - __builtin_clz((unsigned)units - 1);
+}
+
+// First unit of a free block of the given order, or -1 when none is left.
+// The smallest free block that is large enough gets split down to size.
+int buddy_alloc(buddy_t *buddy, int order) {
+    if (order >= buddy->orders) return -1;
+    unsigned candidates = buddy->order_mask & ~((1u << order) - 1);
+    if (candidates == 0) return -1;
+    int k = __builtin_ctz(candidates);
+    int start = buddy->heads[k];
+    unlink_block(buddy, start, k);
+    while (k > order) {
+        k--;
+        push_block(buddy, start + (1 << k), k);
+    }
+    buddy->used_units += 1 << order;
+    return start;
+}
+
+// Give a block back, merging it with its buddy for as long as that is free
+void buddy_free(buddy_t *buddy, int start, int order) {
+    buddy->used_units -= 1 << order;
+    while (order < buddy->orders - 1) {
+        long other = start ^ (1L << order);
+        if (other + (1L << order) > buddy->units || !is_free(buddy, (int)other, order)) {
+            break;
+        }
+        unlink_block(buddy, (int)other, order);
+        start &= ~(1 << order);
+        order++;
+    }
+    push_block(buddy, start, order);
+}
+
+// Units in the largest free block, 0 when nothing is free
+int buddy_largest(const buddy_t *buddy) {
+    return buddy->order_mask ? 1 << (31 - __builtin_clz(buddy->order_mask)) : 0;
+}
+
+// Every free block, order by order, each list from its head
+void buddy_walk(const buddy_t *buddy, void (*visit)(void *context, int start, int order), void *context) {
+    for (int k = 0; k < buddy->orders; k++) {
+        for (int start = buddy->heads[k]; start != -1; start = buddy->next[start]) {
+            visit(context, start, k);
+        }
+    }
+}
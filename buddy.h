@@ -0,0 +1,32 @@
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include <stdint.h>
+
+#define BUDDY_MAX_ORDERS 32  // enough for any int number of units
+
+// Binary buddy allocator over units [0, units). A block of order k is
+// 1 << k units starting at a multiple of its size; its buddy is the block
+// it was split from, start ^ (1 << k). Free blocks sit on one doubly linked
+// list per order, and a bit per block and order says whether it is free, so
+// both allocating and freeing cost O(orders).
+typedef struct {
+    int units;  // order-0 blocks managed
+    int orders;  // the largest block is 1 << (orders - 1) units
+    int heads[BUDDY_MAX_ORDERS];  // most recently freed block of each order, -1 when none
+    unsigned order_mask;  // bit k set when order k has a free block
+    int *next, *prev;  // free list links, indexed by a free block's first unit
+    uint64_t *free_bits[BUDDY_MAX_ORDERS];  // per order, bit i set when block i is free
+    uint64_t *bits;  // backing store of free_bits
+    int used_units;  // units in allocated blocks
+} buddy_t;
+
+void buddy_init(buddy_t *buddy, int units);
+void buddy_destroy(buddy_t *buddy);
+int buddy_order(int units);
+int buddy_alloc(buddy_t *buddy, int order);
+void buddy_free(buddy_t *buddy, int start, int order);
+int buddy_largest(const buddy_t *buddy);
+void buddy_walk(const buddy_t *buddy, void (*visit)(void *context, int start, int order), void *context);
+
+#endif // BUDDY_H
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "events.h"
+#include "instrument.h"
+
+static const char *event_names[] = { "RUNNING", "FINISHED", "EVICTED", "COMPACTED" };
+
+int parse_event_format(const char *name, event_format_t *format) {
+    if (strcmp(name, "text") == 0) {
+        *format = FORMAT_TEXT;
+    } else if (strcmp(name, "csv") == 0) {
+        *format = FORMAT_CSV;
+    } else if (strcmp(name, "binary") == 0) {
+        *format = FORMAT_BINARY;
+    } else if (strcmp(name, "summary") == 0) {
+        *format = FORMAT_SUMMARY;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char* event_format_extension(event_format_t format) {
+    switch (format) {
+    case FORMAT_CSV: return "csv";
+    case FORMAT_BINARY: return "bin";
+    default: return "txt";
+    }
+}
+
+void init_event(event_t *event, int time, event_type_t type, const char *pid) {
+    event->time = time;
+    event->type = type;
+    event->memory_kind = MEMORY_INFINITE;
+    event->pid = pid;
+    event->remaining_time = -1;
+    event->proc_remaining = -1;
+    event->mem_usage = -1;
+    event->address = -1;
+    event->internal_frag = -1;
+    event->frames = NULL;
+    event->frame_count = 0;
+    event->cpu = -1;
+    event->moved = -1;
+}
+
+void begin_event_stream(output_t *out, event_format_t format) {
+    if (format == FORMAT_CSV) {
+        output_str(out, "time,event,pid,remaining_time,proc_remaining,mem_usage,address,frames,cpu,internal_frag,moved_kb\n");
+    } else if (format == FORMAT_BINARY) {
+        unsigned char header[EVENTS_HEADER_SIZE] = { 0 };
+        memcpy(header, EVENTS_MAGIC, 4);
+        header[4] = EVENTS_VERSION & 0xff;
+        header[5] = EVENTS_VERSION >> 8;
+        header[6] = EVENTS_RECORD_SIZE;
+        output_bytes(out, (const char*)header, sizeof(header));
+    }
+}
+
+// Only multi-CPU runs name the CPU, so single-CPU logs read as they always have
+static void write_text_cpu(output_t *out, const event_t *e) {
+    if (e->cpu >= 0) {
+        output_str(out, ",cpu=");
+        output_int(out, e->cpu);
+    }
+}
+
+// The human-readable lines the simulator has always printed
+static void write_text(output_t *out, const event_t *e) {
+    output_int(out, e->time);
+    output_char(out, ',');
+    output_str(out, event_names[e->type]);
+    output_char(out, ',');
+    if (e->type == EVENT_EVICTED) {
+        output_str(out, "evicted-frames=[");
+        for (int i = 0; i < e->frame_count; i++) {
+            if (i > 0) output_char(out, ',');
+            output_int(out, e->frames[i]);
+        }
+        output_str(out, "]\n");
+        return;
+    }
+    if (e->type == EVENT_COMPACTED) {
+        output_str(out, "moved-kb=");
+        output_int(out, e->moved);
+        output_str(out, ",mem-usage=");
+        output_int(out, e->mem_usage);
+        output_str(out, "%\n");
+        return;
+    }
+    output_str(out, "process-name=");
+    output_str(out, e->pid);
+    if (e->type == EVENT_FINISHED) {
+        output_str(out, ",proc-remaining=");
+        output_int(out, e->proc_remaining);
+        write_text_cpu(out, e);
+        output_char(out, '\n');
+        return;
+    }
+    output_str(out, ",remaining-time=");
+    output_int(out, e->remaining_time);
+    if (e->memory_kind == MEMORY_CONTIGUOUS) {
+        output_str(out, ",mem-usage=");
+        output_int(out, e->mem_usage);
+        if (e->internal_frag >= 0) {
+            output_str(out, "%,internal-frag=");
+            output_int(out, e->internal_frag);
+        }
+        output_str(out, "%,allocated-at=");
+        output_int(out, e->address);
+    } else if (e->memory_kind == MEMORY_PAGED) {
+        output_str(out, ",mem-usage=");
+        output_int(out, e->mem_usage);
+        output_str(out, "%,mem-frames=[");
+        for (int i = 0; i < e->frame_count; i++) {
+            if (i > 0) output_str(out, ", ");
+            output_int(out, e->frames[i]);
+        }
+        output_char(out, ']');
+    }
+    write_text_cpu(out, e);
+    output_char(out, '\n');
+}
+
+// empty for fields that do not apply
+static void csv_field(output_t *out, int value) {
+    output_char(out, ',');
+    if (value >= 0) output_int(out, value);
+}
+
+// A pid holding a comma or a quote is quoted, with its quotes doubled (RFC 4180)
+static void csv_text(output_t *out, const char *text) {
+    if (strpbrk(text, ",\"") == NULL) {
+        output_str(out, text);
+        return;
+    }
+    output_char(out, '"');
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"') output_char(out, '"');
+        output_char(out, *c);
+    }
+    output_char(out, '"');
+}
+
+static void write_csv(output_t *out, const event_t *e) {
+    output_int(out, e->time);
+    output_char(out, ',');
+    output_str(out, event_names[e->type]);
+    output_char(out, ',');
+    if (e->pid) csv_text(out, e->pid);
+    csv_field(out, e->remaining_time);
+    csv_field(out, e->proc_remaining);
+    csv_field(out, e->mem_usage);
+    csv_field(out, e->address);
+    output_char(out, ',');
+    for (int i = 0; i < e->frame_count; i++) {
+        if (i > 0) output_char(out, ' ');
+        output_int(out, e->frames[i]);
+    }
+    csv_field(out, e->cpu);
+    csv_field(out, e->internal_frag);
+    csv_field(out, e->moved);
+    output_char(out, '\n');
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+// Little-endian: time, type, memory kind, 16-bit cpu, pid[8], remaining
+// time, proc remaining, mem usage, address, internal fragmentation, frame
+// count, KB moved by a compaction, then the frames.
+// Fields that do not apply hold -1.
+static void write_binary(output_t *out, const event_t *e) {
+    unsigned char r[EVENTS_RECORD_SIZE] = { 0 };
+    put_u32(r, e->time);
+    r[4] = e->type;
+    r[5] = e->memory_kind;
+    r[6] = e->cpu & 0xff;
+    r[7] = (e->cpu >> 8) & 0xff;
+    if (e->pid) strncpy((char*)r + 8, e->pid, 8);
+    put_u32(r + 16, e->remaining_time);
+    put_u32(r + 20, e->proc_remaining);
+    put_u32(r + 24, e->mem_usage);
+    put_u32(r + 28, e->address);
+    put_u32(r + 32, e->internal_frag);
+    put_u32(r + 36, e->frame_count);
+    put_u32(r + 40, e->moved);
+    output_bytes(out, (const char*)r, sizeof(r));
+    for (int i = 0; i < e->frame_count; i++) {
+        unsigned char f[4];
+        put_u32(f, e->frames[i]);
+        output_bytes(out, (const char*)f, sizeof(f));
+    }
+}
+
+void write_event(output_t *out, event_format_t format, const event_t *event) {
+    INSTRUMENT_DECLARE(start);
+    INSTRUMENT_START(start);
+    switch (format) {
+    case FORMAT_TEXT: write_text(out, event); break;
+    case FORMAT_CSV: write_csv(out, event); break;
+    case FORMAT_BINARY: write_binary(out, event); break;
+    case FORMAT_SUMMARY: break;
+    }
+    INSTRUMENT_STOP(PHASE_FORMAT_EVENT, start);
+}
+
+void summary_init(summary_t *summary) {
+    memset(summary, 0, sizeof(*summary));
+}
+
+// Turnaround is finish - arrival; overhead is turnaround over service time
+void summary_add(summary_t *summary, int arrival, int service_time, int finish) {
+    int turnaround = finish - arrival;
+    double overhead = service_time > 0 ? (double)turnaround / service_time : 0;
+    summary->processes++;
+    summary->total_turnaround += turnaround;
+    summary->total_overhead += overhead;
+    if (turnaround > summary->max_turnaround) summary->max_turnaround = turnaround;
+    if (overhead > summary->max_overhead) summary->max_overhead = overhead;
+    if (finish > summary->makespan) summary->makespan = finish;
+}
+
+void write_summary(output_t *out, const summary_t *s) {
+    double n = s->processes ? (double)s->processes : 1;
+    // Faults per hundred accesses; only demand paging replays accesses
+    double fault_rate = s->accesses ? 100.0 * s->page_faults / s->accesses : 0;
+    output_printf(out, "SUMMARY,processes=%ld,avg-turnaround=%.2f,max-turnaround=%d,"
+        "avg-overhead=%.2f,max-overhead=%.2f,makespan=%d,page-faults=%ld,refaults=%ld,evictions=%ld,stuck=%ld,"
+        "max-internal-frag=%d%%,accesses=%ld,fault-rate=%.4f%%,compactions=%ld,compacted-kb=%ld,compaction-time=%ld,"
+        "swap-ins=%ld,swap-outs=%ld,swap-wait=%ld,prefetched=%ld,prefetch-hits=%ld\n",
+        s->processes, s->total_turnaround / n, s->max_turnaround,
+        s->total_overhead / n, s->max_overhead, s->makespan,
+        s->page_faults, s->refaults, s->evictions, s->stuck, s->max_internal_frag,
+        s->accesses, fault_rate, s->compactions, s->compacted_kb, s->compaction_time,
+        s->swap_ins, s->swap_outs, s->swap_wait, s->prefetched, s->prefetch_hits);
+}
+
+// Busy is the time the CPU spent running processes, span the length of the run
+void write_cpu_stats(output_t *out, int cpu, long busy, long span, long migrations) {
+    double utilization = span > 0 ? 100.0 * busy / span : 0;
+    output_printf(out, "CPU,cpu=%d,busy=%ld,utilization=%.2f%%,migrations=%ld\n",
+        cpu, busy, utilization, migrations);
+}
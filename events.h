@@ -0,0 +1,68 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "output.h"
+
+#define EVENTS_MAGIC "RREV"  // first bytes of a binary event stream
+#define EVENTS_VERSION 4
+#define EVENTS_HEADER_SIZE 8
+#define EVENTS_RECORD_SIZE 44  // fixed part of a binary record, before its frames
+
+typedef enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_BINARY, FORMAT_SUMMARY } event_format_t;
+
+typedef enum { EVENT_RUNNING, EVENT_FINISHED, EVENT_EVICTED, EVENT_COMPACTED } event_type_t;
+
+typedef enum { MEMORY_INFINITE, MEMORY_CONTIGUOUS, MEMORY_PAGED } memory_kind_t;
+
+// One scheduler event. Fields that do not apply to it are -1 (NULL pid, no frames).
+typedef struct {
+    int time;
+    event_type_t type;
+    memory_kind_t memory_kind;
+    const char *pid;
+    int remaining_time;  // RUNNING: time the process still needs
+    int proc_remaining;  // FINISHED: processes left in the ready queue
+    int mem_usage;  // percent of memory in use
+    int address;  // contiguous strategies: start of the process's block
+    int internal_frag;  // buddy: percent of memory lost to rounding blocks up
+    const int *frames;  // RUNNING: frames the process holds; EVICTED: frames taken
+    int frame_count;
+    int cpu;  // CPU of a RUNNING or FINISHED process in multi-CPU runs
+    int moved;  // COMPACTED: KB of allocations that changed address
+} event_t;
+
+// Per-run metrics for the summary-only mode
+typedef struct {
+    long processes;
+    double total_turnaround;
+    int max_turnaround;
+    double total_overhead;
+    double max_overhead;
+    int makespan;
+    long page_faults;  // pages loaded into frames
+    long refaults;  // page faults on pages that had been evicted
+    long evictions;
+    long stuck;  // processes still waiting for memory when the run ended
+    int max_internal_frag;  // buddy: highest percent of memory lost inside blocks
+    long accesses;  // memory accesses replayed under demand paging
+    long compactions;  // times contiguous memory was compacted
+    long compacted_kb;  // KB moved by them
+    long compaction_time;  // simulated time charged for them
+    long swap_ins;  // pages read back from swap, prefetched ones included
+    long swap_outs;  // evicted pages written to swap
+    long swap_wait;  // time processes spent waiting for swap-ins after their quanta
+    long prefetched;  // pages read ahead of a swap-in
+    long prefetch_hits;  // of those, pages referenced before being evicted again
+} summary_t;
+
+int parse_event_format(const char *name, event_format_t *format);
+const char* event_format_extension(event_format_t format);
+void init_event(event_t *event, int time, event_type_t type, const char *pid);
+void begin_event_stream(output_t *out, event_format_t format);
+void write_event(output_t *out, event_format_t format, const event_t *event);
+void summary_init(summary_t *summary);
+void summary_add(summary_t *summary, int arrival, int service_time, int finish);
+void write_summary(output_t *out, const summary_t *summary);
+void write_cpu_stats(output_t *out, int cpu, long busy, long span, long migrations);
+
+#endif // EVENTS_H
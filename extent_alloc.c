@@ -0,0 +1,356 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "extent_alloc.h"
+
+static unsigned next_priority(extent_map_t *map) {
+    // xorshift32, seeded per map so runs are reproducible
+    unsigned x = map->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    map->seed = x;
+    return x;
+}
+
+static extent_t* new_extent(extent_map_t *map, int start, int size) {
+    extent_t *e = map->spare;
+    if (e) {
+        map->spare = e->addr_right;
+    } else {
+        e = malloc(sizeof(extent_t));
+        if (!e) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    e->start = start;
+    e->size = size;
+    e->max_size = size;
+    e->priority = next_priority(map);
+    e->addr_left = e->addr_right = NULL;
+    e->size_left = e->size_right = NULL;
+    return e;
+}
+
+static void release_extent(extent_map_t *map, extent_t *e) {
+    e->addr_right = map->spare;
+    map->spare = e;
+}
+
+// address-ordered treap
+
+static int max_size_of(extent_t *t) {
+    return t ? t->max_size : 0;
+}
+
+static void addr_update(extent_t *t) {
+    int m = t->size;
+    if (max_size_of(t->addr_left) > m) m = max_size_of(t->addr_left);
+    if (max_size_of(t->addr_right) > m) m = max_size_of(t->addr_right);
+    t->max_size = m;
+}
+
+// split t into holes starting before key and holes starting at or after key
+static void addr_split(extent_t *t, int key, extent_t **left, extent_t **right) {
+    if (!t) {
+        *left = *right = NULL;
+    } else if (t->start < key) {
+        addr_split(t->addr_right, key, &t->addr_right, right);
+        addr_update(t);
+        *left = t;
+    } else {
+        addr_split(t->addr_left, key, left, &t->addr_left);
+        addr_update(t);
+        *right = t;
+    }
+}
+
+static extent_t* addr_merge(extent_t *left, extent_t *right) {
+    if (!left) return right;
+    if (!right) return left;
+    if (left->priority > right->priority) {
+        left->addr_right = addr_merge(left->addr_right, right);
+        addr_update(left);
+        return left;
+    }
+    right->addr_left = addr_merge(left, right->addr_left);
+    addr_update(right);
+    return right;
+}
+
+static extent_t* addr_insert(extent_t *t, extent_t *x) {
+    if (!t) return x;
+    if (x->priority > t->priority) {
+        addr_split(t, x->start, &x->addr_left, &x->addr_right);
+        addr_update(x);
+        return x;
+    }
+    if (x->start < t->start) {
+        t->addr_left = addr_insert(t->addr_left, x);
+    } else {
+        t->addr_right = addr_insert(t->addr_right, x);
+    }
+    addr_update(t);
+    return t;
+}
+
+static extent_t* addr_remove(extent_t *t, extent_t *x) {
+    if (t == x) return addr_merge(t->addr_left, t->addr_right);
+    if (x->start < t->start) {
+        t->addr_left = addr_remove(t->addr_left, x);
+    } else {
+        t->addr_right = addr_remove(t->addr_right, x);
+    }
+    addr_update(t);
+    return t;
+}
+
+// lowest-addressed hole of at least size that starts at or after from
+static extent_t* addr_first_fit(extent_t *t, int from, int size) {
+    while (t && t->max_size >= size) {
+        if (t->start < from) {
+            t = t->addr_right;
+            continue;
+        }
+        extent_t *found = addr_first_fit(t->addr_left, from, size);
+        if (found) return found;
+        if (t->size >= size) return t;
+        // everything to the right starts after from, so only size matters
+        from = t->start;
+        t = t->addr_right;
+    }
+    return NULL;
+}
+
+// size-ordered treap, ties broken by address
+
+static int size_less(extent_t *a, extent_t *b) {
+    return a->size < b->size || (a->size == b->size && a->start < b->start);
+}
+
+static void size_split(extent_t *t, extent_t *key, extent_t **left, extent_t **right) {
+    if (!t) {
+        *left = *right = NULL;
+    } else if (size_less(t, key)) {
+        size_split(t->size_right, key, &t->size_right, right);
+        *left = t;
+    } else {
+        size_split(t->size_left, key, left, &t->size_left);
+        *right = t;
+    }
+}
+
+static extent_t* size_merge(extent_t *left, extent_t *right) {
+    if (!left) return right;
+    if (!right) return left;
+    if (left->priority > right->priority) {
+        left->size_right = size_merge(left->size_right, right);
+        return left;
+    }
+    right->size_left = size_merge(left, right->size_left);
+    return right;
+}
+
+static extent_t* size_insert(extent_t *t, extent_t *x) {
+    if (!t) return x;
+    if (x->priority > t->priority) {
+        size_split(t, x, &x->size_left, &x->size_right);
+        return x;
+    }
+    if (size_less(x, t)) {
+        t->size_left = size_insert(t->size_left, x);
+    } else {
+        t->size_right = size_insert(t->size_right, x);
+    }
+    return t;
+}
+
+static extent_t* size_remove(extent_t *t, extent_t *x) {
+    if (t == x) return size_merge(t->size_left, t->size_right);
+    if (size_less(x, t)) {
+        t->size_left = size_remove(t->size_left, x);
+    } else {
+        t->size_right = size_remove(t->size_right, x);
+    }
+    return t;
+}
+
+// smallest hole of at least size, lowest address among equals
+static extent_t* size_best_fit(extent_t *t, int size) {
+    extent_t *best = NULL;
+    while (t) {
+        if (t->size >= size) {
+            best = t;
+            t = t->size_left;
+        } else {
+            t = t->size_right;
+        }
+    }
+    return best;
+}
+
+static void link_extent(extent_map_t *map, extent_t *e) {
+    e->addr_left = e->addr_right = NULL;
+    e->size_left = e->size_right = NULL;
+    e->max_size = e->size;
+    map->by_addr = addr_insert(map->by_addr, e);
+    map->by_size = size_insert(map->by_size, e);
+}
+
+static void unlink_extent(extent_map_t *map, extent_t *e) {
+    map->by_addr = addr_remove(map->by_addr, e);
+    map->by_size = size_remove(map->by_size, e);
+}
+
+// carve size KB off the front of hole e and return its old start
+static int take_from(extent_map_t *map, extent_t *e, int size) {
+    int start = e->start;
+    unlink_extent(map, e);
+    e->start += size;
+    e->size -= size;
+    if (e->size > 0) {
+        link_extent(map, e);
+    } else {
+        release_extent(map, e);
+        map->holes--;
+    }
+    map->free_total -= size;
+    return start;
+}
+
+void extent_map_init(extent_map_t *map, int total) {
+    map->by_addr = NULL;
+    map->by_size = NULL;
+    map->spare = NULL;
+    map->seed = 2463534242u;
+    map->total = total;
+    map->free_total = 0;
+    map->holes = 0;
+    map->rover = 0;
+    if (total > 0) {
+        link_extent(map, new_extent(map, 0, total));
+        map->free_total = total;
+        map->holes = 1;
+    }
+}
+
+static void destroy_tree(extent_t *t) {
+    if (!t) return;
+    destroy_tree(t->addr_left);
+    destroy_tree(t->addr_right);
+    free(t);
+}
+
+void extent_map_destroy(extent_map_t *map) {
+    destroy_tree(map->by_addr);
+    while (map->spare) {
+        extent_t *next = map->spare->addr_right;
+        free(map->spare);
+        map->spare = next;
+    }
+    map->by_addr = NULL;
+    map->by_size = NULL;
+}
+
+int extent_alloc_first(extent_map_t *map, int size) {
+    if (size <= 0) return -1;
+    extent_t *e = addr_first_fit(map->by_addr, 0, size);
+    return e ? take_from(map, e, size) : -1;
+}
+
+int extent_alloc_best(extent_map_t *map, int size) {
+    if (size <= 0) return -1;
+    extent_t *e = size_best_fit(map->by_size, size);
+    return e ? take_from(map, e, size) : -1;
+}
+
+int extent_alloc_next(extent_map_t *map, int size) {
+    if (size <= 0) return -1;
+    extent_t *e = addr_first_fit(map->by_addr, map->rover, size);
+    if (!e) {
+        e = addr_first_fit(map->by_addr, 0, size);  // wrap around
+    }
+    if (!e) return -1;
+    int start = take_from(map, e, size);
+    map->rover = start + size;
+    return start;
+}
+
+void extent_free(extent_map_t *map, int start, int size) {
+    if (size <= 0) return;
+
+    // neighbouring holes: the last one before start and the first one after
+    extent_t *pred = NULL, *succ = NULL;
+    for (extent_t *t = map->by_addr; t; ) {
+        if (t->start < start) {
+            pred = t;
+            t = t->addr_right;
+        } else {
+            succ = t;
+            t = t->addr_left;
+        }
+    }
+
+    map->free_total += size;
+    if (pred && pred->start + pred->size == start) {
+        unlink_extent(map, pred);
+        pred->size += size;
+        if (succ && start + size == succ->start) {
+            unlink_extent(map, succ);
+            pred->size += succ->size;
+            release_extent(map, succ);
+            map->holes--;
+        }
+        link_extent(map, pred);
+    } else if (succ && start + size == succ->start) {
+        unlink_extent(map, succ);
+        succ->start = start;
+        succ->size += size;
+        link_extent(map, succ);
+    } else {
+        link_extent(map, new_extent(map, start, size));
+        map->holes++;
+    }
+}
+
+static void release_tree(extent_map_t *map, extent_t *t) {
+    while (t) {
+        release_tree(map, t->addr_left);
+        extent_t *right = t->addr_right;
+        release_extent(map, t);
+        t = right;
+    }
+}
+
+// The caller has slid every allocation down to address 0, so all the free
+// memory is now one hole at the top
+void extent_map_compact(extent_map_t *map) {
+    release_tree(map, map->by_addr);
+    map->by_addr = NULL;
+    map->by_size = NULL;
+    map->holes = 0;
+    map->rover = map->total - map->free_total;
+    if (map->free_total > 0) {
+        link_extent(map, new_extent(map, map->rover, map->free_total));
+        map->holes = 1;
+    }
+}
+
+// Size of the largest hole, so callers can tell whether an allocation can succeed
+int extent_largest(const extent_map_t *map) {
+    return max_size_of(map->by_addr);
+}
+
+static void walk_tree(const extent_t *t, void (*visit)(void *context, int start, int size), void *context) {
+    while (t) {
+        walk_tree(t->addr_left, visit, context);
+        visit(context, t->start, t->size);
+        t = t->addr_right;
+    }
+}
+
+// Every hole, lowest address first
+void extent_map_walk(const extent_map_t *map, void (*visit)(void *context, int start, int size), void *context) {
+    walk_tree(map->by_addr, visit, context);
+}
@@ -0,0 +1,38 @@
+#ifndef EXTENT_ALLOC_H
+#define EXTENT_ALLOC_H
+
+// A free hole [start, start + size) in the contiguous memory.
+// Every hole sits in two treaps at once: one ordered by address (augmented
+// with the largest hole of each subtree, for first fit and next fit) and one
+// ordered by (size, address) for best fit.
+typedef struct extent {
+    int start;
+    int size;
+    unsigned priority;
+    int max_size;  // largest hole in this node's address subtree
+    struct extent *addr_left, *addr_right;
+    struct extent *size_left, *size_right;
+} extent_t;
+
+typedef struct {
+    extent_t *by_addr;  // root of the address-ordered treap
+    extent_t *by_size;  // root of the size-ordered treap
+    extent_t *spare;  // released extent nodes, chained through addr_right
+    unsigned seed;  // deterministic priority generator
+    int total;  // managed memory size in KB
+    int free_total;  // KB currently free
+    int holes;  // number of free holes
+    int rover;  // where the next next-fit search starts
+} extent_map_t;
+
+void extent_map_init(extent_map_t *map, int total);
+void extent_map_destroy(extent_map_t *map);
+int extent_alloc_first(extent_map_t *map, int size);
+int extent_alloc_best(extent_map_t *map, int size);
+int extent_alloc_next(extent_map_t *map, int size);
+void extent_free(extent_map_t *map, int start, int size);
+int extent_largest(const extent_map_t *map);
+void extent_map_compact(extent_map_t *map);
+void extent_map_walk(const extent_map_t *map, void (*visit)(void *context, int start, int size), void *context);
+
+#endif // EXTENT_ALLOC_H
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "feed.h"
+
+#define FEED_CONSUMER 1
+#define FEED_PRODUCER 2
+#define FEED_MASK (FEED_RECORDS - 1)
+
+// The indices and flags use sequentially consistent operations: a side
+// sets its sleeping bit and then checks the ring, the other side stores an
+// index and then checks the bit, so one of them always sees the other.
+
+static int consumer_ready(trace_feed_t *feed) {
+    return atomic_load(&feed->tail) != atomic_load(&feed->head) || atomic_load(&feed->done) != 0;
+}
+
+// A full ring is left to drain by half, so the producer sleeps and wakes
+// once per half ring rather than once per record taken
+static int producer_ready(trace_feed_t *feed) {
+    return feed->written - atomic_load(&feed->head) <= FEED_RECORDS / 2 || atomic_load(&feed->stop);
+}
+
+// Polls for a while, then sleeps on wake, until ready holds
+static void wait_until(trace_feed_t *feed, int side, int (*ready)(trace_feed_t *)) {
+    for (int i = 0; i < FEED_SPINS; i++) {
+        if (ready(feed)) return;
+    }
+    pthread_mutex_lock(&feed->lock);
+    atomic_fetch_or(&feed->sleeping, side);
+    while (!ready(feed)) {
+        pthread_cond_wait(&feed->wake, &feed->lock);
+    }
+    atomic_fetch_and(&feed->sleeping, ~side);
+    pthread_mutex_unlock(&feed->lock);
+}
+
+static void wake_sleepers(trace_feed_t *feed) {
+    pthread_mutex_lock(&feed->lock);
+    pthread_cond_broadcast(&feed->wake);
+    pthread_mutex_unlock(&feed->lock);
+}
+
+static void publish(trace_feed_t *feed) {
+    atomic_store(&feed->tail, feed->written);
+    if (atomic_load(&feed->sleeping) & FEED_CONSUMER) {
+        wake_sleepers(feed);
+    }
+}
+
+// Record sink of the producer: records are published a batch at a time
+static int feed_put(void *ctx, const process_record_t *record) {
+    trace_feed_t *feed = ctx;
+    if (feed->written - feed->head_seen == FEED_RECORDS) {
+        feed->head_seen = atomic_load(&feed->head);
+        if (feed->written - feed->head_seen == FEED_RECORDS) {
+            publish(feed);
+            wait_until(feed, FEED_PRODUCER, producer_ready);
+            if (atomic_load(&feed->stop)) return -1;
+            feed->head_seen = atomic_load(&feed->head);
+        }
+    }
+    feed->ring[feed->written & FEED_MASK] = *record;
+    feed->written++;
+    if ((feed->written & (FEED_BATCH - 1)) == 0) {
+        publish(feed);
+        if (atomic_load(&feed->stop)) return -1;
+    }
+    return 0;
+}
+
+static void* produce(void *arg) {
+    trace_feed_t *feed = arg;
+    int status = 0;
+    if (feed->binary) {
+        process_record_t record;
+        int more;
+        while (status == 0 && (more = trace_stream_next(&feed->stream, &record)) != 0) {
+            status = more < 0 ? -1 : feed_put(feed, &record);
+        }
+    } else {
+        status = scan_trace(feed->filename, feed_put, feed);
+    }
+    publish(feed);
+    atomic_store(&feed->done, status != 0 && !atomic_load(&feed->stop) ? -1 : 1);
+    if (atomic_load(&feed->sleeping) & FEED_CONSUMER) {
+        wake_sleepers(feed);
+    }
+    return NULL;
+}
+
+static void release_feed(trace_feed_t *feed) {
+    if (feed->binary) {
+        trace_stream_close(&feed->stream);
+    }
+    free(feed->ring);
+    pthread_mutex_destroy(&feed->lock);
+    pthread_cond_destroy(&feed->wake);
+}
+
+// Starts parsing the trace, text or binary, on its own thread. Returns -1
+// when it cannot be opened; a bad line further on ends the trace there and
+// makes trace_feed_stop() fail.
+int trace_feed_start(trace_feed_t *feed, const char *filename) {
+    feed->filename = filename;
+    feed->binary = is_binary_trace(filename);
+    if (feed->binary) {
+        if (trace_stream_open(&feed->stream, filename, TRACE_CHUNK_RECORDS) != 0) {
+            return -1;
+        }
+    } else {
+        // Fail before the simulation starts when there is nothing to read
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Failed to open file\n");
+            return -1;
+        }
+        close(fd);
+    }
+    feed->ring = malloc(FEED_RECORDS * sizeof(process_record_t));
+    pthread_mutex_init(&feed->lock, NULL);
+    pthread_cond_init(&feed->wake, NULL);
+    if (!feed->ring) {
+        fprintf(stderr, "Memory allocation failed\n");
+        release_feed(feed);
+        return -1;
+    }
+    atomic_init(&feed->sleeping, 0);
+    atomic_init(&feed->done, 0);
+    atomic_init(&feed->stop, 0);
+    atomic_init(&feed->tail, 0);
+    atomic_init(&feed->head, 0);
+    feed->written = 0;
+    feed->head_seen = 0;
+    feed->tail_seen = 0;
+    if (pthread_create(&feed->producer, NULL, produce, feed) != 0) {
+        fprintf(stderr, "Failed to start the trace reader\n");
+        release_feed(feed);
+        return -1;
+    }
+    return 0;
+}
+
+// Takes up to max records in trace order, waiting for the producer while
+// the ring is empty. Returns how many, 0 at the end of the trace, or -1
+// once every record before a bad one has been taken.
+long trace_feed_pop(trace_feed_t *feed, process_record_t *records, long max) {
+    size_t head = atomic_load(&feed->head);
+    if (feed->tail_seen == head) {
+        feed->tail_seen = atomic_load(&feed->tail);
+        if (feed->tail_seen == head) {
+            wait_until(feed, FEED_CONSUMER, consumer_ready);
+            feed->tail_seen = atomic_load(&feed->tail);
+            if (feed->tail_seen == head) return atomic_load(&feed->done) < 0 ? -1 : 0;
+        }
+    }
+    size_t count = feed->tail_seen - head;
+    if (count > (size_t)max) {
+        count = max;
+    }
+    size_t at = head & FEED_MASK;
+    size_t first = count < FEED_RECORDS - at ? count : FEED_RECORDS - at;
+    memcpy(records, feed->ring + at, first * sizeof(process_record_t));
+    memcpy(records + first, feed->ring, (count - first) * sizeof(process_record_t));
+    atomic_store(&feed->head, head + count);
+    // A sleeping producer has published everything it wrote, so tail tells
+    // whether it is ready yet
+    if ((atomic_load(&feed->sleeping) & FEED_PRODUCER) && atomic_load(&feed->tail) - (head + count) <= FEED_RECORDS / 2) {
+        wake_sleepers(feed);
+    }
+    return count;
+}
+
+// Drops the first count records; -1 when the trace is shorter
+int trace_feed_skip(trace_feed_t *feed, long count) {
+    process_record_t records[FEED_BATCH];
+    while (count > 0) {
+        long taken = trace_feed_pop(feed, records, count < FEED_BATCH ? count : FEED_BATCH);
+        if (taken <= 0) return -1;
+        count -= taken;
+    }
+    return 0;
+}
+
+// Stops the producer, wherever it is, and frees the ring. Returns -1 when
+// the trace had a bad line.
+int trace_feed_stop(trace_feed_t *feed) {
+    atomic_store(&feed->stop, 1);
+    wake_sleepers(feed);
+    pthread_join(feed->producer, NULL);
+    int status = atomic_load(&feed->done) < 0 ? -1 : 0;
+    release_feed(feed);
+    return status;
+}
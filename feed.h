@@ -0,0 +1,42 @@
+#ifndef FEED_H
+#define FEED_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "trace.h"
+
+#define FEED_RECORDS 16384  // ring slots, a power of two
+#define FEED_BATCH 256  // records parsed before they are published, and taken per pop
+#define FEED_SPINS 256  // polls of the ring before a side sleeps
+
+// A trace parsed on a producer thread and handed to the simulation through
+// a bounded single-producer single-consumer ring, so parsing overlaps the
+// simulation and at most FEED_RECORDS records are held at once. Each side
+// only ever stores its own index, so records change hands without a lock;
+// a side that finds the ring full or empty for long sleeps on wake until
+// the other side moves.
+typedef struct {
+    process_record_t *ring;
+    const char *filename;
+    trace_stream_t stream;  // binary traces only
+    int binary;
+    pthread_t producer;
+    pthread_mutex_t lock;  // only taken to sleep or to wake a sleeper
+    pthread_cond_t wake;
+    atomic_int sleeping;  // FEED_CONSUMER and FEED_PRODUCER bits of the sides asleep on wake
+    atomic_int done;  // set by the producer at the end of the trace: 1, or -1 after an error
+    atomic_int stop;  // set by the consumer to make the producer give up early
+    _Alignas(64) atomic_size_t tail;  // records published, stored by the producer
+    size_t written;  // records in the ring, published or not; producer only
+    size_t head_seen;  // head as the producer last read it
+    _Alignas(64) atomic_size_t head;  // records taken, stored by the consumer
+    size_t tail_seen;  // tail as the consumer last read it
+} trace_feed_t;
+
+int trace_feed_start(trace_feed_t *feed, const char *filename);
+long trace_feed_pop(trace_feed_t *feed, process_record_t *records, long max);
+int trace_feed_skip(trace_feed_t *feed, long count);
+int trace_feed_stop(trace_feed_t *feed);
+
+#endif // FEED_H
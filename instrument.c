@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "instrument.h"
+
+#define INSTRUMENT_BUCKETS 65  // bucket b > 0 holds costs in [2^(b-1), 2^b), bucket 0 zero
+
+typedef struct {
+    uint64_t calls;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[INSTRUMENT_BUCKETS];
+} phase_stats_t;
+
+// One block per thread so sweep workers never contend; blocks stay
+// registered after their thread exits and are summed at exit
+typedef struct instrument_block {
+    phase_stats_t phases[PHASE_COUNT];
+    uint64_t counters[COUNTER_COUNT];
+    struct instrument_block *next;
+} instrument_block_t;
+
+static const char *phase_names[PHASE_COUNT] = {
+    "scheduler_pass", "contiguous_alloc", "allocate_pages", "allocate_virtual", "replay_accesses", "find_victim", "format_event"
+};
+
+static const char *counter_names[COUNTER_COUNT] = {
+    "frames_scanned", "bitmap_words", "evictions", "blocked_scanned"
+};
+
+static _Thread_local instrument_block_t *local_block;
+static instrument_block_t *all_blocks;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INSTRUMENT_UNIT "cycles"
+uint64_t instrument_now(void) {
+    return __rdtsc();
+}
+#else
+#define INSTRUMENT_UNIT "ns"
+uint64_t instrument_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+// Upper bound of the histogram bucket that the q-th quantile falls in
+static uint64_t quantile(const phase_stats_t *p, double q) {
+    uint64_t rank = (uint64_t)(q * p->calls);
+    uint64_t seen = 0;
+    for (int b = 0; b < INSTRUMENT_BUCKETS; b++) {
+        seen += p->buckets[b];
+        if (seen > rank) {
+            return b == 0 ? 0 : (b >= 64 ? UINT64_MAX : (1ull << b) - 1);
+        }
+    }
+    return p->max;
+}
+
+static void instrument_dump(void) {
+    instrument_block_t sum = { 0 };
+    pthread_mutex_lock(&blocks_lock);
+    for (instrument_block_t *block = all_blocks; block != NULL; block = block->next) {
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            phase_stats_t *p = &sum.phases[i];
+            const phase_stats_t *q = &block->phases[i];
+            p->calls += q->calls;
+            p->total += q->total;
+            if (q->max > p->max) p->max = q->max;
+            for (int b = 0; b < INSTRUMENT_BUCKETS; b++) {
+                p->buckets[b] += q->buckets[b];
+            }
+        }
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            sum.counters[i] += block->counters[i];
+        }
+    }
+    pthread_mutex_unlock(&blocks_lock);
+
+    fprintf(stderr, "%-18s %12s %16s %12s %12s %12s %14s\n", "phase (" INSTRUMENT_UNIT ")",
+        "calls", "total", "mean", "p50<=", "p99<=", "max");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const phase_stats_t *p = &sum.phases[i];
+        if (p->calls == 0) continue;
+        fprintf(stderr, "%-18s %12llu %16llu %12.1f %12llu %12llu %14llu\n", phase_names[i],
+            (unsigned long long)p->calls, (unsigned long long)p->total, (double)p->total / p->calls,
+            (unsigned long long)quantile(p, 0.5), (unsigned long long)quantile(p, 0.99),
+            (unsigned long long)p->max);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        fprintf(stderr, "%-18s %12llu\n", counter_names[i], (unsigned long long)sum.counters[i]);
+    }
+}
+
+static instrument_block_t* block(void) {
+    if (local_block == NULL) {
+        local_block = calloc(1, sizeof(instrument_block_t));
+        if (!local_block) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        pthread_mutex_lock(&blocks_lock);
+        if (all_blocks == NULL) {
+            atexit(instrument_dump);
+        }
+        local_block->next = all_blocks;
+        all_blocks = local_block;
+        pthread_mutex_unlock(&blocks_lock);
+    }
+    return local_block;
+}
+
+void instrument_record(instrument_phase_t phase, uint64_t elapsed) {
+    phase_stats_t *p = &block()->phases[phase];
+    p->calls++;
+    p->total += elapsed;
+    if (elapsed > p->max) p->max = elapsed;
+    p->buckets[elapsed ? 64 - __builtin_clzll(elapsed) : 0]++;
+}
+
+void instrument_add(instrument_counter_t counter, uint64_t n) {
+    block()->counters[counter] += n;
+}
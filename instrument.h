@@ -0,0 +1,57 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+// Hot-path instrumentation, compiled in only with -DINSTRUMENT (make
+// INSTRUMENT=1). Every phase gets a call count and a log2 histogram of its
+// cost; counters tally work done inside the phases. The breakdown is written
+// to stderr when the program exits. Without INSTRUMENT every macro is empty.
+
+#include <stdint.h>
+
+typedef enum {
+    PHASE_SCHEDULER_PASS,  // one pass of a scheduler's main loop
+    PHASE_CONTIGUOUS_ALLOC,  // first_fit, best_fit, next_fit or buddy
+    PHASE_ALLOCATE_PAGES,  // paged top-up, evictions included
+    PHASE_ALLOCATE_VIRTUAL,  // virtual top-up, evictions included
+    PHASE_REPLAY_ACCESSES,  // one quantum of demand-paged accesses, faults included
+    PHASE_FIND_VICTIM,  // the replacement policy picking a frame to evict
+    PHASE_FORMAT_EVENT,  // formatting one event into the output buffer
+    PHASE_COUNT
+} instrument_phase_t;
+
+typedef enum {
+    COUNTER_FRAMES_SCANNED,  // frames looked at while choosing or ordering victims
+    COUNTER_BITMAP_WORDS,  // free-frame bitmap words read
+    COUNTER_EVICTIONS,
+    COUNTER_BLOCKED_SCANNED,  // waiting processes looked at for a wake-up
+    COUNTER_COUNT
+} instrument_counter_t;
+
+#ifdef INSTRUMENT
+
+uint64_t instrument_now(void);
+void instrument_record(instrument_phase_t phase, uint64_t elapsed);
+void instrument_add(instrument_counter_t counter, uint64_t n);
+
+#define INSTRUMENT_DECLARE(t) uint64_t t = 0
+#define INSTRUMENT_START(t) ((t) = instrument_now())
+#define INSTRUMENT_STOP(phase, t) instrument_record((phase), instrument_now() - (t))
+// Record the time since the previous lap, then start the next one
+#define INSTRUMENT_LAP(phase, t) do { \
+        uint64_t instrument_lap_ = instrument_now(); \
+        if (t) instrument_record((phase), instrument_lap_ - (t)); \
+        (t) = instrument_lap_; \
+    } while (0)
+#define INSTRUMENT_COUNT(counter, n) instrument_add((counter), (n))
+
+#else
+
+#define INSTRUMENT_DECLARE(t)
+#define INSTRUMENT_START(t) ((void)0)
+#define INSTRUMENT_STOP(phase, t) ((void)0)
+#define INSTRUMENT_LAP(phase, t) ((void)0)
+#define INSTRUMENT_COUNT(counter, n) ((void)0)
+
+#endif // INSTRUMENT
+
+#endif // INSTRUMENT_H
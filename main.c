@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "memory_management.h"
+#include "snapshot.h"
+#include "sweep.h"
+
+// Split a comma-separated flag value in place; returns the number of items
+static int split_list(char *value, char **items, int max_items) {
+    int count = 0;
+    for (char *item = strtok(value, ","); item != NULL; item = strtok(NULL, ",")) {
+        if (count == max_items) {
+            return -1;
+        }
+        items[count++] = item;
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+
+    // if the input parameters correct
+    if (argc < 7 || argc % 2 == 0) {
+        printf("Invalid input!\n");
+        return 0;
+    }
+
+    char* filename = NULL;
+    char* quantum_arg = NULL;
+    char* strategy_arg = NULL;
+    char* out_dir = NULL;
+    char* log_file = NULL;
+    event_format_t format = FORMAT_TEXT;
+    int memory_kb = MAX_MEMORY;
+    int page_size = PAGE_SIZE;
+    int min_pages = MIN_PAGES;
+    char* policy_arg = NULL;
+    char* scheduler_arg = NULL;
+    int ws_window = WS_WINDOW;
+    int cpus = 1;
+    int threads = 0;
+    char* snapshot_file = NULL;
+    char* resume_file = NULL;
+    int snapshot_time = 0;
+    char* access_arg = NULL;
+    int access_rate = ACCESS_RATE;
+    char* compact_arg = NULL;
+    char* swap_arg = NULL;
+    int prefetch = 0;
+
+    for (int i = 1; i < argc; i += 2) {
+        if (strcmp(argv[i], "-f") == 0) {
+            filename = argv[i + 1];
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quantum_arg = argv[i + 1];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            strategy_arg = argv[i + 1];
+        } else if (strcmp(argv[i], "-o") == 0) {
+            out_dir = argv[i + 1];
+        } else if (strcmp(argv[i], "-l") == 0) {
+            log_file = argv[i + 1];
+        } else if (strcmp(argv[i], "-e") == 0) {
+            if (parse_event_format(argv[i + 1], &format) != 0) {
+                fprintf(stderr, "Unsupported event format\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-M") == 0) {
+            memory_kb = parse_size_kb(argv[i + 1]);
+        } else if (strcmp(argv[i], "-P") == 0) {
+            page_size = parse_size_kb(argv[i + 1]);
+        } else if (strcmp(argv[i], "-N") == 0) {
+            min_pages = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-r") == 0) {
+            policy_arg = argv[i + 1];
+        } else if (strcmp(argv[i], "-s") == 0) {
+            scheduler_arg = argv[i + 1];
+        } else if (strcmp(argv[i], "-W") == 0) {
+            ws_window = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            cpus = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-S") == 0) {
+            snapshot_file = argv[i + 1];
+        } else if (strcmp(argv[i], "-t") == 0) {
+            snapshot_time = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-R") == 0) {
+            resume_file = argv[i + 1];
+        } else if (strcmp(argv[i], "-a") == 0) {
+            access_arg = argv[i + 1];
+        } else if (strcmp(argv[i], "-A") == 0) {
+            access_rate = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-C") == 0) {
+            compact_arg = argv[i + 1];
+        } else if (strcmp(argv[i], "-w") == 0) {
+            swap_arg = argv[i + 1];
+        } else if (strcmp(argv[i], "-p") == 0) {
+            prefetch = atoi(argv[i + 1]);
+        }
+    }
+
+    if (filename == NULL || strategy_arg == NULL || quantum_arg == NULL) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    // Memory geometry: total size (-M), page size (-P) and minimum resident pages (-N)
+    sim_config_t config;
+    if (init_config(&config, memory_kb, page_size, min_pages) != 0) {
+        fprintf(stderr, "Invalid memory geometry\n");
+        return 1;
+    }
+    config.ws_window = ws_window;
+    if (cpus < 1 || cpus > MAX_CPUS) {
+        fprintf(stderr, "Invalid number of CPUs\n");
+        return 1;
+    }
+    config.cpus = cpus;
+
+    // -q and -m take comma-separated lists, but only a sweep (-o) runs more than one
+    char *quantum_items[SWEEP_MAX_ITEMS];
+    int quanta[SWEEP_MAX_ITEMS];
+    char *strategies[SWEEP_MAX_ITEMS];
+    int num_quanta = split_list(quantum_arg, quantum_items, SWEEP_MAX_ITEMS);
+    int num_strategies = split_list(strategy_arg, strategies, SWEEP_MAX_ITEMS);
+    if (num_quanta <= 0 || num_strategies <= 0 ||
+        (out_dir == NULL && (num_quanta > 1 || num_strategies > 1))) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    for (int i = 0; i < num_quanta; i++) {
+        quanta[i] = atoi(quantum_items[i]);
+        if (quanta[i] <= 0) {
+            fprintf(stderr, "Invalid arguments\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < num_strategies; i++) {
+        if (!is_valid_strategy(strategies[i])) {
+            fprintf(stderr, "Unsupported memory strategy\n");
+            return 1;
+        }
+    }
+
+    // -r names the page replacement policy, or a list of them for a sweep
+    replacement_policy_t policies[SWEEP_MAX_ITEMS] = { POLICY_LRU };
+    int num_policies = 1;
+    if (policy_arg != NULL) {
+        char *policy_items[SWEEP_MAX_ITEMS];
+        num_policies = split_list(policy_arg, policy_items, SWEEP_MAX_ITEMS);
+        if (num_policies <= 0 || (out_dir == NULL && num_policies > 1)) {
+            fprintf(stderr, "Invalid arguments\n");
+            return 1;
+        }
+        for (int i = 0; i < num_policies; i++) {
+            if (parse_policy(policy_items[i], &policies[i]) != 0) {
+                fprintf(stderr, "Unsupported replacement policy\n");
+                return 1;
+            }
+        }
+    }
+    config.policy = policies[0];
+
+    // -s names the scheduler, or a list of them for a sweep
+    scheduler_t schedulers[SWEEP_MAX_ITEMS] = { SCHEDULER_RR };
+    int num_schedulers = 1;
+    if (scheduler_arg != NULL) {
+        char *scheduler_items[SWEEP_MAX_ITEMS];
+        num_schedulers = split_list(scheduler_arg, scheduler_items, SWEEP_MAX_ITEMS);
+        if (num_schedulers <= 0 || (out_dir == NULL && num_schedulers > 1)) {
+            fprintf(stderr, "Invalid arguments\n");
+            return 1;
+        }
+        for (int i = 0; i < num_schedulers; i++) {
+            if (parse_scheduler(scheduler_items[i], &schedulers[i]) != 0) {
+                fprintf(stderr, "Unsupported scheduler\n");
+                return 1;
+            }
+        }
+    }
+    config.scheduler = schedulers[0];
+
+    // -a makes virtual page on demand, replaying a locality model or an
+    // access trace at -A accesses per second of CPU
+    access_trace_t access_trace = { NULL, 0, NULL, 0 };
+    if (access_rate <= 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    config.access.rate = access_rate;
+    if (access_arg != NULL) {
+        if (parse_access_model(access_arg, &config.access) != 0) {
+            fprintf(stderr, "Invalid access model\n");
+            return 1;
+        }
+        if (config.access.kind == ACCESS_TRACE) {
+            if (load_access_trace(&access_trace, access_arg) != 0) {
+                return 1;
+            }
+            config.access.trace = &access_trace;
+        }
+    }
+
+    // -C <percent>[:<time per MB>] compacts contiguous memory once that
+    // percent of the free memory lies outside the largest hole
+    if (compact_arg != NULL) {
+        char *end;
+        long threshold = strtol(compact_arg, &end, 10);
+        long cost = COMPACT_COST;
+        if (*end == ':') {
+            char *cost_arg = end + 1;
+            cost = strtol(cost_arg, &end, 10);
+            if (end == cost_arg) cost = -1;
+        }
+        if (end == compact_arg || *end != '\0' || threshold < 0 || threshold > 100 || cost < 0 || cost > INT_MAX / 2048) {
+            fprintf(stderr, "Invalid compaction setting\n");
+            return 1;
+        }
+        config.compact_threshold = (int)threshold;
+        config.compact_cost = (int)cost;
+    }
+
+    // -w <read latency>[:<read KB per time unit>[:<write latency>[:<write KB
+    // per time unit>]]] writes evicted pages to a swap device and reads them
+    // back; -p reads that many pages ahead of a demand-paging swap-in
+    if (swap_arg != NULL && parse_swap_config(swap_arg, &config.swap) != 0) {
+        fprintf(stderr, "Invalid swap device\n");
+        return 1;
+    }
+    if (prefetch < 0 || (prefetch > 0 && swap_arg == NULL)) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+    config.swap.prefetch = prefetch;
+
+    // Snapshots (-S at time -t) and resuming from one (-R) are for single runs
+    if (out_dir != NULL && (snapshot_file != NULL || resume_file != NULL)) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    if (out_dir != NULL) {
+        // Sweep: load the trace once and share it between every run
+        trace_t trace;
+        if (load_trace(&trace, filename) != 0) {
+            return 1;
+        }
+        int status = run_sweep(&trace, &config, out_dir, quanta, num_quanta, strategies, num_strategies,
+                               policies, num_policies, schedulers, num_schedulers, format, threads);
+        free_trace(&trace);
+        free_access_trace(&access_trace);
+        return status == 0 ? 0 : 1;
+    }
+
+    // The event log goes to stdout unless -l names a file, or "none" to discard it
+    int out_fd = STDOUT_FILENO;
+    if (log_file != NULL && strcmp(log_file, "none") == 0) {
+        out_fd = OUTPUT_DISCARD;
+    } else if (log_file != NULL && strcmp(log_file, "-") != 0) {
+        out_fd = open(log_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (out_fd < 0) {
+            fprintf(stderr, "Failed to open file %s\n", log_file);
+            return 1;
+        }
+    }
+
+    sim_t *sim = malloc(sizeof(sim_t));
+    assert(sim);
+    if (resume_file != NULL) {
+        // The snapshot brings its own memory geometry, policy, CPUs and scheduler
+        if (read_snapshot(sim, resume_file, out_fd) != 0) {
+            free(sim);
+            return 1;
+        }
+        // An access trace is not saved with the snapshot, so -a names it again
+        if (sim->config.access.kind == ACCESS_TRACE) {
+            if (config.access.kind != ACCESS_TRACE) {
+                fprintf(stderr, "Snapshot replays an access trace, give it with -a\n");
+                sim_destroy(sim);
+                free(sim);
+                return 1;
+            }
+            sim->config.access.trace = &access_trace;
+        }
+    } else {
+        sim_init(sim, &config, out_fd);
+    }
+    sim->format = format;
+    sim->snapshot_path = snapshot_file;
+    sim->snapshot_time = snapshot_time;
+    // The trace is parsed on another thread while the simulation runs
+    trace_feed_t feed;
+    int status = trace_feed_start(&feed, filename);
+    if (status == 0) {
+        sim->input_feed = &feed;
+        status = sim->resumed ? resume_trace(sim) : 0;
+        if (status == 0) {
+            status = run_simulation(sim, quanta[0], strategies[0]);
+        }
+        if (trace_feed_stop(&feed) != 0) {
+            status = -1;
+        }
+    }
+    sim_destroy(sim);
+    free_access_trace(&access_trace);
+    free(sim);
+    if (out_fd != STDOUT_FILENO && out_fd != OUTPUT_DISCARD && close(out_fd) != 0) {
+        fprintf(stderr, "Failed to write file %s\n", log_file);
+        status = -1;
+    }
+    return status == 0 ? 0 : 1;
+}
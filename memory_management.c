@@ -4,13 +4,93 @@
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
+#include <stdarg.h>
 #include "memory_management.h"
 
-void initialize_frames() {
-    for (int i = 0; i < NUM_FRAMES; i++) {
-        frames[i].in_use = 0;
-        frames[i].last_used = 0;
+// Free-form notes only belong in the text log; they would corrupt the
+// machine-readable formats and summary mode prints nothing per event.
+void diagnostic(sim_t *sim, const char *format, ...) {
+    if (sim->format != FORMAT_TEXT) return;
+    va_list args;
+    va_start(args, format);
+    output_vprintf(&sim->out, format, args);
+    va_end(args);
+}
+
+// Pages needed to hold kb, rounded up. Power-of-two page sizes, which is
+// every common geometry, take the shift instead of the divide.
+static int pages_for(sim_t *sim, int kb) {
+    if (sim->config.page_shift >= 0) {
+        return (int)(((long)kb + sim->config.page_size - 1) >> sim->config.page_shift);
+    }
+    return (int)(((long)kb + sim->config.page_size - 1) / sim->config.page_size);
+}
+
+static void* alloc_or_die(size_t size) {
+    void *p = malloc(size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+void initialize_frames(sim_t *sim) {
+    for (int i = 0; i < sim->config.num_frames; i++) {
+        sim->frames[i].last_used = 0;
+        sim->frames[i].referenced = 0;
+        sim->frames[i].bucket = -1;
+        sim->frames[i].owner_slot = -1;
+        sim->frames[i].lru_prev = sim->frames[i].lru_next = -1;
+        sim->frames[i].page = -1;
+        sim->frames[i].touched = sim->frames[i].evicted_in = 0;
+        sim->frames[i].prefetched = 0;
+    }
+    for (int w = 0; w < sim->config.frame_words; w++) {
+        sim->frame_bitmap[w] = 0;
+    }
+    sim->used_frames = 0;
+    sim->lru_head = -1;
+    sim->lru_tail = -1;
+    for (int i = 0; i < sim->config.num_frames; i++) {
+        sim->frames[i].owner = -1;
+    }
+}
+
+int frame_in_use(sim_t *sim, int frame_number) {
+    return (sim->frame_bitmap[frame_number >> 6] >> (frame_number & 63)) & 1;
+}
+
+// Every frame changes state here, so used_frames stays exact
+void mark_frame_used(sim_t *sim, int frame_number) {
+    sim->used_frames += !frame_in_use(sim, frame_number);
+    sim->frame_bitmap[frame_number >> 6] |= (uint64_t)1 << (frame_number & 63);
+}
+
+void mark_frame_free(sim_t *sim, int frame_number) {
+    sim->used_frames -= frame_in_use(sim, frame_number);
+    sim->frame_bitmap[frame_number >> 6] &= ~((uint64_t)1 << (frame_number & 63));
+}
+
+// Free bits of bitmap word w, with the bits past the last frame masked off
+static uint64_t free_frame_bits(sim_t *sim, int w) {
+    INSTRUMENT_COUNT(COUNTER_BITMAP_WORDS, 1);
+    uint64_t bits = ~sim->frame_bitmap[w];
+    if (w == sim->config.frame_words - 1 && (sim->config.num_frames & 63) != 0) {
+        bits &= ((uint64_t)1 << (sim->config.num_frames & 63)) - 1;
     }
+    return bits;
+}
+
+// Lowest-numbered free frame, or -1 when every frame is in use
+int find_free_frame(sim_t *sim) {
+    for (int w = 0; w < sim->config.frame_words; w++) {
+        uint64_t bits = free_frame_bits(sim, w);
+        if (bits) {
+            return (w << 6) + __builtin_ctzll(bits);
+        }
+    }
+    return -1;
 }
 
 list_t* make_empty_list(void) {
@@ -19,6 +99,7 @@ list_t* make_empty_list(void) {
 
     list->head = NULL;
     list->foot = NULL;
+    list->count = 0;
     return list;
 }
 
@@ -31,6 +112,7 @@ void insert_at_foot(list_t* list, node_t* new_node) {
         list->foot = new_node;
     }
     new_node->next = NULL;
+    list->count++;
 }
 
 node_t* remove_from_front(list_t* list){
@@ -46,101 +128,286 @@ if (list == NULL || list->head == NULL) {
     }
 
     temp->next = NULL;
+    list->count--;
     return temp;
 }
 
-node_t* create_node(char* pid, int arr_time, int remain_time, int memory) {
-    node_t* new_node = malloc(sizeof(node_t));
-    if (!new_node) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
-    }
+void initialize_node_pool(sim_t *sim) {
+    pool_init(&sim->node_pool, sizeof(node_t));
+}
+
+// Hands every node and page table back to the system in one go
+void destroy_node_pool(sim_t *sim) {
+    pool_destroy(&sim->node_pool);
+}
+
+node_t* create_node(sim_t *sim, const char* pid, int arr_time, int remain_time, int memory) {
+    node_t* new_node = pool_alloc_object(&sim->node_pool);
     strcpy(new_node->pid, pid);
     new_node->arr_time = arr_time;
     new_node->remain_time = remain_time;
+    new_node->service_time = remain_time;
     new_node->memory = memory;
     new_node->addr = -1;  // Memory not yet allocated
+    new_node->page_to_frame_mapping = NULL;
+    new_node->assigned_frames = NULL;
+    new_node->num_pages = 0;
     new_node->state = READY;
+    new_node->frames_count = 0;
+    new_node->id = -1;
+    new_node->evicted_pages = 0;
+    new_node->cpu = -1;
+    new_node->seq = sim->arrivals++;
+    new_node->level = 0;
+    new_node->slice_used = 0;
+    new_node->heap_index = -1;
+    access_start(&sim->config.access, &new_node->access, new_node->seq);
+    new_node->swap_reads = 0;
+    new_node->swap_pages = 0;
+    new_node->swap_ready = 0;
+    new_node->required_pages = memory > 0 ? pages_for(sim, memory) : 0;
     new_node->next = NULL;
     new_node->isValid = 1;
     return new_node;
 }
 
+// Page tables are only needed by the paged strategies, so they are carved
+// from the pool the first time a process asks for frames.
+void ensure_page_table(sim_t *sim, node_t *node) {
+    if (node->assigned_frames) return;
+    int pages = node->required_pages;
+    register_process(sim, node);
+    int *table = pool_alloc_ints(&sim->node_pool, 2 * (size_t)pages);
+    node->assigned_frames = table;
+    node->page_to_frame_mapping = table + pages;
+    for (int i = 0; i < pages; i++) {
+        node->page_to_frame_mapping[i] = -1;
+    }
+}
+
+// Return a finished node and its page table to the pool for reuse
+void release_node(sim_t *sim, node_t *node) {
+    unregister_process(sim, node);
+    pool_release_ints(&sim->node_pool, node->assigned_frames, 2 * (size_t)node->required_pages);
+    node->assigned_frames = NULL;
+    node->page_to_frame_mapping = NULL;
+    node->isValid = 0;
+    pool_release_object(&sim->node_pool, node);
+}
+
 int isValidNode(node_t* node) {
     return node != NULL && node->isValid;
 }
 
-void read_input(list_t* input_queue, char* filename) {
-    FILE* fp = fopen(filename, "r");
-    if (!fp) {
-        fprintf(stderr, "Failed to open file\n");
-        exit(1);
+// Next process still to arrive. Processes come from sim->trace or, as they
+// are parsed, sim->input_feed; the queue only ever holds one chunk of them
+// and is topped up here as it drains.
+node_t* peek_arrival(sim_t *sim, list_t* input_queue) {
+    if (input_queue->head == NULL && sim->trace != NULL) {
+        for (int i = 0; i < TRACE_CHUNK_RECORDS && sim->trace_pos < sim->trace->count; i++) {
+            const process_record_t *record = &sim->trace->records[sim->trace_pos++];
+            insert_at_foot(input_queue, create_node(sim, record->pid, record->arr_time, record->run_time, record->memory));
+        }
+    } else if (input_queue->head == NULL && sim->input_feed != NULL) {
+        process_record_t records[FEED_BATCH];
+        long count = trace_feed_pop(sim->input_feed, records, FEED_BATCH);
+        if (count < 0) {
+            sim->input_failed = 1;
+            count = 0;
+        }
+        for (long i = 0; i < count; i++) {
+            insert_at_foot(input_queue, create_node(sim, records[i].pid, records[i].arr_time, records[i].run_time, records[i].memory));
+        }
+        sim->trace_pos += count;
     }
+    return input_queue->head;
+}
 
-    int arr_time, remain_time, memory;
-    char pid[MAX_LEN + 1];
+void initialize_memory(sim_t *sim) {
+    extent_map_init(&sim->memory_map, sim->config.memory_kb);
+    sim->buddy.units = 0;
+    sim->buddy_requested = 0;
+}
 
-    while (fscanf(fp, "%d %s %d %d", &arr_time, pid, &remain_time, &memory) == 4) {
-        node_t* new_node = create_node(pid, arr_time, remain_time, memory);
-        insert_at_foot(input_queue, new_node);
+static int report_fit(sim_t *sim, node_t *node, int addr) {
+    if (addr == -1) {
+        diagnostic(sim, "Failed to allocate size %d, procee: %s\n", node->memory, node->pid);
+        return -1;
     }
+    node->addr = addr;
+    return addr;
+}
 
-    fclose(fp);
+int first_fit(sim_t *sim, node_t *node) {
+    if (node->memory <= 0) return -1;
+    return report_fit(sim, node, extent_alloc_first(&sim->memory_map, node->memory));
 }
 
-int first_fit(node_t *node) {
+int best_fit(sim_t *sim, node_t *node) {
     if (node->memory <= 0) return -1;
-    for (int i = 0; i < MAX_MEMORY; i++) {
-        int free = 1;
-        for (int j = i; j < i + node->memory; j++) {
-            if (memory[j] != 0) {
-                free = 0;
-                break;
-            }
-        }
-        if (free) {
-            node->addr = i;
-            for (int k = i; k < i + node->memory; k++) {
-                memory[k] = 1;
-            }
-            return i;
-        }
+    return report_fit(sim, node, extent_alloc_best(&sim->memory_map, node->memory));
+}
+
+int next_fit(sim_t *sim, node_t *node) {
+    if (node->memory <= 0) return -1;
+    return report_fit(sim, node, extent_alloc_next(&sim->memory_map, node->memory));
+}
+
+// Blocks of 2^k pages, so requests are rounded up to a power of two pages
+int buddy_fit(sim_t *sim, node_t *node) {
+    if (node->memory <= 0) return -1;
+    if (sim->buddy.units == 0) {
+        buddy_init(&sim->buddy, sim->config.num_frames);
     }
-    printf("Failed to allocate size %d, procee: %s\n", node->memory, node->pid);
-    return -1;
+    int unit = buddy_alloc(&sim->buddy, buddy_order(pages_for(sim, node->memory)));
+    if (unit == -1) {
+        return report_fit(sim, node, -1);
+    }
+    sim->buddy_requested += node->memory;
+    int waste = calculate_internal_fragmentation(sim);
+    if (waste > sim->summary.max_internal_frag) {
+        sim->summary.max_internal_frag = waste;
+    }
+    return report_fit(sim, node, unit * sim->config.page_size);
+}
+
+int is_contiguous_strategy(char *strategy) {
+    return strcmp(strategy, "first_fit") == 0 || strcmp(strategy, "best_fit") == 0 ||
+        strcmp(strategy, "next_fit") == 0 || strcmp(strategy, "buddy") == 0;
+}
+
+int is_valid_strategy(char *strategy) {
+    return strcmp(strategy, "infinite") == 0 || is_contiguous_strategy(strategy) ||
+        strcmp(strategy, "paged") == 0 || strcmp(strategy, "virtual") == 0;
 }
 
-void deallocate(node_t *node) {
+int contiguous_allocate(sim_t *sim, node_t *node, char *strategy) {
+    if (strcmp(strategy, "best_fit") == 0) {
+        return best_fit(sim, node);
+    } else if (strcmp(strategy, "next_fit") == 0) {
+        return next_fit(sim, node);
+    } else if (strcmp(strategy, "buddy") == 0) {
+        return buddy_fit(sim, node);
+    }
+    return first_fit(sim, node);
+}
+
+void deallocate(sim_t *sim, node_t *node, char *strategy) {
     // Check if the address is valid before trying to deallocate
-    if (node->addr < 0 || node->addr + node->memory > MAX_MEMORY) {
+    if (node->addr < 0 || (long)node->addr + node->memory > sim->config.memory_kb) {
         return; // Return immediately without attempting to deallocate
     }
-    
-    // Proceed with deallocation if the address is valid
-    for (int i = node->addr; i <  node->addr + node->memory; i++) {
-        memory[i] = 0;
+
+    if (strcmp(strategy, "buddy") == 0) {
+        // Give the block back, merging it with its free buddies
+        buddy_free(&sim->buddy, node->addr / sim->config.page_size, buddy_order(pages_for(sim, node->memory)));
+        sim->buddy_requested -= node->memory;
+        return;
     }
+    // Give the range back, merging it with the holes on either side
+    extent_free(&sim->memory_map, node->addr, node->memory);
+}
+
+// The extent map keeps free_total up to date on every allocation and free
+int calculate_memory_usage_first_fit(sim_t *sim, node_t *node){
+    (void)node;
+    int used_memory = sim->memory_map.total - sim->memory_map.free_total;
+    return (int)((double)used_memory / sim->config.memory_kb * 100);
 }
 
-int calculate_memory_usage_first_fit(node_t *node){
-    int used_memory = 0;
-    for (int i = 0; i < MAX_MEMORY; i++) {
-        if (memory[i]) {
-            used_memory++;
+// Whole blocks count as used under buddy, the waste inside them included
+int calculate_memory_usage_buddy(sim_t *sim) {
+    return (int)((double)sim->buddy.used_units * sim->config.page_size / sim->config.memory_kb * 100);
+}
+
+// Percent of memory lost inside buddy blocks to rounding requests up
+int calculate_internal_fragmentation(sim_t *sim) {
+    double wasted = (double)sim->buddy.used_units * sim->config.page_size - sim->buddy_requested;
+    return (int)(wasted / sim->config.memory_kb * 100);
+}
+
+// Percent of the free contiguous memory outside its largest hole, 0 when it is all one hole
+int external_fragmentation(sim_t *sim) {
+    int free_total = sim->memory_map.free_total;
+    if (free_total == 0) return 0;
+    return (int)((long)(free_total - extent_largest(&sim->memory_map)) * 100 / free_total);
+}
+
+// Whether compacting would make room for need KB and the free memory is
+// scattered enough for the copying to be worth it. Buddy blocks must stay
+// aligned, so buddy never compacts.
+static int compaction_pays(sim_t *sim, int need, char *strategy) {
+    return sim->config.compact_threshold >= 0 && strcmp(strategy, "buddy") != 0 &&
+        need > 0 && need <= sim->memory_map.free_total &&
+        external_fragmentation(sim) >= sim->config.compact_threshold;
+}
+
+typedef struct {
+    node_t **nodes;
+    int count;
+} resident_t;
+
+static void add_resident(void *context, node_t *node) {
+    resident_t *resident = context;
+    if (node->addr >= 0) {
+        resident->nodes[resident->count++] = node;
+    }
+}
+
+static int compare_addr(const void *a, const void *b) {
+    int x = (*(node_t * const *)a)->addr, y = (*(node_t * const *)b)->addr;
+    return (x > y) - (x < y);
+}
+
+// Slide every allocation down to address 0, keeping their order, so the
+// free memory becomes one hole at the top. The copying costs
+// config.compact_cost per MB moved, charged to the current quantum.
+// Returns the KB moved.
+int compact_memory(sim_t *sim, int time) {
+    // Only queued processes hold memory; a blocked one never got any
+    int queued = sim->ready_queue.count;
+    if (sim->cpus) {
+        for (int c = 0; c < sim->config.cpus; c++) {
+            queued += sim->cpus[c].queue.count;
         }
     }
-    return (int)((double)used_memory / MAX_MEMORY * 100);
+    resident_t resident = { alloc_or_die((queued > 0 ? queued : 1) * sizeof(node_t *)), 0 };
+    runqueue_walk(&sim->ready_queue, add_resident, &resident);
+    if (sim->cpus) {
+        for (int c = 0; c < sim->config.cpus; c++) {
+            runqueue_walk(&sim->cpus[c].queue, add_resident, &resident);
+        }
+    }
+    qsort(resident.nodes, resident.count, sizeof(node_t *), compare_addr);
+    int cursor = 0, moved = 0;
+    for (int i = 0; i < resident.count; i++) {
+        node_t *node = resident.nodes[i];
+        if (node->addr != cursor) {
+            moved += node->memory;
+            node->addr = cursor;
+        }
+        cursor += node->memory;
+    }
+    free(resident.nodes);
+    extent_map_compact(&sim->memory_map);
+
+    int cost = (int)(((long)moved * sim->config.compact_cost + 1023) / 1024);
+    sim->stall += cost;
+    sim->summary.compactions++;
+    sim->summary.compacted_kb += moved;
+    sim->summary.compaction_time += cost;
+    event_t event;
+    init_event(&event, time, EVENT_COMPACTED, NULL);
+    event.memory_kind = MEMORY_CONTIGUOUS;
+    event.moved = moved;
+    event.mem_usage = calculate_memory_usage_first_fit(sim, NULL);
+    write_event(&sim->out, sim->format, &event);
+    return moved;
 }
 
+// Nodes belong to node_pool and are freed in bulk by destroy_node_pool()
 void free_list(list_t *list) {
     if (list != NULL) {
-        node_t *current = list->head;
-        node_t *next;
-        while (current != NULL) {
-            next = current->next;
-            free(current);
-            current = next;
-        }
         free(list);
     }
 }
@@ -150,296 +417,746 @@ int ready_queue_length(list_t *list) {
         fprintf(stderr, "Error: Passed a NULL list to ready_queue_length.\n");
         return 0; // If the list pointer is NULL, return 0
     }
-    int count = 0;
-    node_t *current = list->head;
-    while (current != NULL) {
-        count++;
-        if (current->next && !isValidNode(current->next)) {
-            fprintf(stderr, "Error: Detected a corrupted or freed node in the list.\n");
-            break; // Break the loop if the next node is detected as invalid
+    return list->count;
+}
+
+int calculate_memory_usage(sim_t *sim) {
+    return (int)((double)sim->used_frames / sim->config.num_frames * 100);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Frames are listed in ascending order. Evictions swap-remove entries,
+// so re-sort the process's own list when needed and fix the back links.
+void sort_owned_frames(sim_t *sim, node_t *node) {
+    int count = node->frames_count;
+    int sorted = 1;
+    for (int i = 1; i < count && sorted; i++) {
+        sorted = node->assigned_frames[i - 1] < node->assigned_frames[i];
+    }
+    if (!sorted) {
+        qsort(node->assigned_frames, count, sizeof(int), compare_ints);
+        for (int i = 0; i < count; i++) {
+            sim->frames[node->assigned_frames[i]].owner_slot = i;
         }
-        current = current->next;
     }
-    return count;
 }
 
-int calculate_memory_usage() {
-    int used_frames = 0;
-    for (int i = 0; i < NUM_FRAMES; i++) {
-        if (frames[i].in_use) {
-            used_frames++;
+// Process table: frames name their owner by a small integer id, handed out
+// when a process first gets a page table and recycled when it finishes.
+void register_process(sim_t *sim, node_t *node) {
+    if (sim->process_table.free_count > 0) {
+        node->id = sim->process_table.free_ids[--sim->process_table.free_count];
+    } else {
+        if (sim->process_table.count == sim->process_table.capacity) {
+            int capacity = sim->process_table.capacity ? sim->process_table.capacity * 2 : 64;
+            sim->process_table.nodes = realloc(sim->process_table.nodes, capacity * sizeof(node_t*));
+            sim->process_table.free_ids = realloc(sim->process_table.free_ids, capacity * sizeof(int));
+            if (!sim->process_table.nodes || !sim->process_table.free_ids) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            sim->process_table.capacity = capacity;
         }
+        node->id = sim->process_table.count++;
     }
-    return (int)((double)used_frames / NUM_FRAMES * 100);
+    sim->process_table.nodes[node->id] = node;
 }
 
-char* format_frames_list(node_t *node, int count) {
-    int estimated_size = count * 6 + 2; // Slightly larger to accommodate commas and spaces
-    char* buffer = malloc(estimated_size);
-    if (!buffer) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return NULL;
+void unregister_process(sim_t *sim, node_t *node) {
+    if (node->id < 0) return;
+    sim->process_table.nodes[node->id] = NULL;
+    sim->process_table.free_ids[sim->process_table.free_count++] = node->id;
+    node->id = -1;
+}
+
+void destroy_process_table(sim_t *sim) {
+    free(sim->process_table.nodes);
+    free(sim->process_table.free_ids);
+    sim->process_table.nodes = NULL;
+    sim->process_table.free_ids = NULL;
+    sim->process_table.count = sim->process_table.capacity = sim->process_table.free_count = 0;
+}
+
+// Append frame_number to the process's own frame list
+static void add_owned_frame(sim_t *sim, node_t *process, int frame_number) {
+    sim->frames[frame_number].owner = process->id;
+    sim->frames[frame_number].owner_slot = process->frames_count;
+    process->assigned_frames[process->frames_count++] = frame_number;
+}
+
+// Take frame_number out of its owner's frame list by moving the last entry into its slot
+static void drop_owned_frame(sim_t *sim, int frame_number) {
+    int owner_id = sim->frames[frame_number].owner;
+    if (owner_id < 0) return;
+    node_t *owner = sim->process_table.nodes[owner_id];
+    int slot = sim->frames[frame_number].owner_slot;
+    int last = owner->assigned_frames[--owner->frames_count];
+    owner->assigned_frames[slot] = last;
+    sim->frames[last].owner_slot = slot;
+    sim->frames[frame_number].owner = -1;
+}
+
+// Mark a free frame as used at current_time and hand it to the replacement policy
+static void use_frame(sim_t *sim, int frame_number, int current_time) {
+    mark_frame_used(sim, frame_number);
+    policy_insert(sim, frame_number, current_time);
+}
+
+// Give a free frame to the process for one of its pages: a page fault,
+// and a refault when the page had been evicted before. The frames loaded
+// by one allocation go to the replacement policy together, see
+// policy_owned_frames.
+static void load_page(sim_t *sim, node_t *process, int frame_number) {
+    mark_frame_used(sim, frame_number);
+    if (process->frames_count == 0) {  // addr points to the first allocated frame
+        process->addr = frame_number;
     }
-    char* ptr = buffer;
-    int first = 1; 
-    ptr += sprintf(ptr, "[");
-    for (int i = 0; i < NUM_FRAMES; i++) {
-        if (strcmp(frames[i].pid, node->pid) == 0) { // 检查帧是否属于指定的进程
-            if (!first) {
-                ptr += sprintf(ptr, ", ");
-            } else {
-                first = 0; // 首个元素后设置为0，后续的前面都要加逗号
-            }
-            ptr += sprintf(ptr, "%d", i);
-        }
+    add_owned_frame(sim, process, frame_number);
+    sim->summary.page_faults++;
+    if (process->evicted_pages > 0) {
+        process->evicted_pages--;
+        sim->summary.refaults++;
     }
-    sprintf(ptr, "]");
-    return buffer;
 }
 
-int evict_page_paged(int current_time) {
-    int lru_index = -1;
-    int oldest_time = INT_MAX;
-    
-    for (int i = 0; i < NUM_FRAMES; i++) {
-        if (frames[i].in_use && frames[i].last_used < oldest_time) {
-            oldest_time = frames[i].last_used;
-            lru_index = i;
-        }
+// The frames process holds from slot from on were referenced (touch) or
+// loaded at current_time. The policy takes them in one batch, which sorts
+// them, so their slots are fixed up after.
+static void policy_owned_frames(sim_t *sim, node_t *process, int from, int touch, int current_time) {
+    int *frames = process->assigned_frames + from;
+    int count = process->frames_count - from;
+    if (touch) {
+        policy_touch_batch(sim, frames, count, current_time);
+    } else {
+        policy_insert_batch(sim, frames, count, current_time);
     }
+    for (int i = from; i < process->frames_count; i++) {
+        sim->frames[process->assigned_frames[i]].owner_slot = i;
+    }
+}
 
-    if (lru_index != -1) {
-        frames[lru_index].in_use = 0;
-        frames[lru_index].last_used = current_time;  // Reset time since it's being evicted
-        return lru_index;
+// Take an in-use frame away from its owner
+static void evict_frame(sim_t *sim, int frame_number) {
+    node_t *owner = sim->process_table.nodes[sim->frames[frame_number].owner];
+    owner->evicted_pages++;
+    if (sim->frames[frame_number].page >= 0) {
+        owner->page_to_frame_mapping[sim->frames[frame_number].page] = PAGE_EVICTED;
     }
+    sim->summary.evictions++;
+    sim->swap_writes += sim->config.swap.enabled;  // written back as the quantum ends
+    INSTRUMENT_COUNT(COUNTER_EVICTIONS, 1);
+    free_frame(sim, frame_number);
+}
 
-    printf("No frames available to evict\n");
+int evict_page_paged(sim_t *sim, node_t *process, int current_time) {
+    int victim = policy_victim(sim, process, current_time);
+
+    if (victim != -1) {
+        evict_frame(sim, victim);
+        return victim;
+    }
+
+    diagnostic(sim, "No frames available to evict\n");
     return -1;
 }
 
-EvictResult allocate_pages(node_t* process, int current_time) {
+// Frames of the processes waiting on swap, which nobody can take from them
+static int frames_held_for_swap(sim_t *sim) {
+    int held = 0;
+    for (node_t *node = sim->swapping.head; node != NULL; node = node->next) {
+        held += node->frames_count;
+    }
+    return held;
+}
+
+// Tops the process up to all of its pages; frames it lost to evictions
+// since it last ran are allocated again.
+EvictResult allocate_pages(sim_t *sim, node_t* process, int current_time) {
     EvictResult result;
-    result.evicted_frames = calloc(NUM_FRAMES, sizeof(int)); // remember to free after use
+    result.evicted_frames = sim->evicted;  // valid until the next allocation
     result.num_evicted = 0;
     result.success = 0;
 
-    int needed_pages = (process->memory + PAGE_SIZE - 1) / PAGE_SIZE;
-    if (needed_pages > NUM_FRAMES) {
-        printf("Process %s requires more pages (%d) than available frames (%d).\n", process->pid, needed_pages, NUM_FRAMES);
+    int needed_pages = process->required_pages;
+    if (needed_pages > sim->config.num_frames) {
+        diagnostic(sim, "Process %s requires more pages (%d) than available frames (%d).\n", process->pid, needed_pages, sim->config.num_frames);
         return result;
     }
-    
-    int allocated_pages = 0;
-
-    for (int i = 0; i < NUM_FRAMES && allocated_pages < needed_pages; i++) {
-        if (!frames[i].in_use) {  // Check if the frame is free
-            frames[i].in_use = 1;  // Mark the frame as used
-            frames[i].last_used = current_time;  // Update the last used time
-            process->assigned_frames[allocated_pages] = i;  // Store the frame number
-            if (allocated_pages == 0) { // Update addr to point to the first allocated frame
-                process->addr = i;
-            }
-            allocated_pages++;
+    // Evicting is no use until the processes waiting on swap are back
+    if (needed_pages > sim->config.num_frames - frames_held_for_swap(sim)) {
+        return result;
+    }
+    ensure_page_table(sim, process);
+
+    // The process references the frames it still holds, and evictions below never pick them
+    policy_owned_frames(sim, process, 0, 1, current_time);
+    int held_pages = process->frames_count;
+
+    // Take free frames in ascending order, a bitmap word at a time
+    for (int w = 0; w < sim->config.frame_words && process->frames_count < needed_pages; w++) {
+        uint64_t bits = free_frame_bits(sim, w);
+        while (bits && process->frames_count < needed_pages) {
+            int i = (w << 6) + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            load_page(sim, process, i);
         }
     }
 
     // If more frames are needed, try to evict used frames
-    while (allocated_pages < needed_pages) {
-        int evicted_frame = evict_page_paged(current_time);  // Evict a page
+    while (process->frames_count < needed_pages) {
+        int evicted_frame = evict_page_paged(sim, process, current_time);  // Evict a page
         if (evicted_frame != -1) {
-            frames[evicted_frame].in_use = 1;  // Mark the frame as used
-            frames[evicted_frame].last_used = current_time;  // Update the last used time
-            process->assigned_frames[allocated_pages] = evicted_frame;  // Store the frame number
-            
-
-            if (allocated_pages == 0){
-                process->addr = evicted_frame;
-            }
-            
-            allocated_pages++;
+            load_page(sim, process, evicted_frame);
             result.evicted_frames[result.num_evicted++] = evicted_frame;
         } else {
-            printf("Failed to evict any frame, all frames are in use.\n");
-            // Rollback any frames already marked as in use if we cannot meet the needed pages
-            for (int i = 0; i < allocated_pages; i++) {
-                frames[process->assigned_frames[i]].in_use = 0;
+            diagnostic(sim, "Failed to evict any frame, all frames are in use.\n");
+            // Rollback the frames taken by this call if we cannot meet the needed pages
+            policy_owned_frames(sim, process, held_pages, 0, current_time);
+            while (process->frames_count > held_pages) {
+                free_frame(sim, process->assigned_frames[process->frames_count - 1]);
             }
             return result; // Return failure if not enough frames can be allocated
         }
     }
 
-    process->frames_count = allocated_pages;
-    result.success = allocated_pages == needed_pages;  // Return success if all needed pages are successfully allocated
+    policy_owned_frames(sim, process, held_pages, 0, current_time);
+    result.success = process->frames_count == needed_pages;  // Return success if all needed pages are successfully allocated
     return result;
 }
 
 
 // virtual memory allocation implement
 
-int* find_least_used_frames(int num_frames_to_evict) {
-    int* least_used_frames = malloc(num_frames_to_evict * sizeof(int));
-    if (!least_used_frames) return NULL;
+void free_frame(sim_t *sim, int frame_number) {
+    if (frame_number >= 0 && frame_number < sim->config.num_frames) {
+        mark_frame_free(sim, frame_number);  // marked as not in use
+        policy_remove(sim, frame_number);
+        drop_owned_frame(sim, frame_number);
+        sim->frames[frame_number].last_used = 0;  // reset the last used time
+        sim->frames[frame_number].page = -1;
+        sim->frames[frame_number].prefetched = 0;
+    }
+}
 
-    // Initialize the array with -1.
-    for (int i = 0; i < num_frames_to_evict; i++) {
-        least_used_frames[i] = -1;
+// Give back every frame a finished process still holds
+void release_frames(sim_t *sim, node_t *process) {
+    while (process->frames_count > 0) {
+        free_frame(sim, process->assigned_frames[process->frames_count - 1]);
     }
+}
 
-    // We will track the number of frames placed into the least_used_frames array.
-    int frames_placed = 0;
+void print_evicted_frames(sim_t *sim, int time, int *evicted_frames, int num_evicted) {
+    if (num_evicted > 0) {
+        event_t event;
+        init_event(&event, time, EVENT_EVICTED, NULL);
+        event.frames = evicted_frames;
+        event.frame_count = num_evicted;
+        write_event(&sim->out, sim->format, &event);
+    }
+}
 
-    // Iterate over all frames to find the least used ones.
-    while (frames_placed < num_frames_to_evict) {
-        int frame_to_place = -1;
-        int oldest_use = INT_MAX; // Use the maximum int value as the initial oldest use.
+EvictResult allocate_virtual_pages(sim_t *sim, node_t* process, int current_time) {
+    EvictResult result;
+    result.evicted_frames = sim->evicted;
+    result.num_evicted = 0;
+    result.success = 0;
 
-        // Find the least recently used frame that is not already in the least_used_frames array.
-        for (int i = 0; i < NUM_FRAMES; i++) {
-            if (frames[i].in_use) {
-                int is_already_chosen = 0;
-                for (int j = 0; j < frames_placed; j++) {
-                    if (least_used_frames[j] == i) {
-                        is_already_chosen = 1;
-                        break;
-                    }
-                }
-                if (!is_already_chosen && frames[i].last_used <= oldest_use) {
-                    // If the last_used is equal, prefer the smaller frame index.
-                    if (frames[i].last_used < oldest_use || frame_to_place == -1) {
-                        oldest_use = frames[i].last_used;
-                        frame_to_place = i;
-                    }
-                }
-            }
+    int needed_pages = process->required_pages;
+    if (needed_pages > sim->config.num_frames) {
+        diagnostic(sim, "Process %s requires more pages (%d) than available frames (%d).\n", process->pid, needed_pages, sim->config.num_frames);
+        return result;
+    }
+    int min_required_pages = needed_pages < sim->config.min_pages ? needed_pages : sim->config.min_pages;
+    ensure_page_table(sim, process);
+
+    // Frames already allocated to this process are only referenced again
+    policy_owned_frames(sim, process, 0, 1, current_time);
+    int held_pages = process->frames_count;
+
+    // Then top up from the free frames, lowest numbered first
+    for (int w = 0; w < sim->config.frame_words && process->frames_count < needed_pages; w++) {
+        uint64_t bits = free_frame_bits(sim, w);
+        while (bits && process->frames_count < needed_pages) {
+            int i = (w << 6) + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            load_page(sim, process, i);
         }
+    }
 
-        // If we found a frame to place, add it to the array.
-        if (frame_to_place != -1) {
-            least_used_frames[frames_placed] = frame_to_place;
-            frames_placed++;
-        } else {
-            // No more frames can be evicted; we break out of the loop.
-            break;
+    // Still short of the minimum: evict other processes' frames as the policy picks them
+    while (process->frames_count < min_required_pages) {
+        int frame_to_evict = policy_victim(sim, process, current_time);
+        if (frame_to_evict == -1) break;
+        evict_frame(sim, frame_to_evict);
+        load_page(sim, process, frame_to_evict);  // realloce the evicted frame to the process
+        result.evicted_frames[result.num_evicted++] = frame_to_evict;
+    }
+    policy_owned_frames(sim, process, held_pages, 0, current_time);
+    print_evicted_frames(sim, current_time, result.evicted_frames, result.num_evicted);
+    
+    result.success = process->frames_count >= min_required_pages;
+    
+    return result;
+}
+
+// Demand paging: a frame for a page of requester, free if there is one,
+// otherwise taken by the policy from another process, or from any process
+// when requester is NULL. -1 when the policy finds none.
+static int take_frame(sim_t *sim, node_t *requester, int time, int *num_evicted) {
+    int frame = sim->used_frames < sim->config.num_frames ? find_free_frame(sim) : -1;
+    if (frame == -1) {
+        frame = policy_victim(sim, requester, time);
+        if (frame == -1) return -1;
+        evict_frame(sim, frame);
+        // EVICTED lists each frame once however often it changed hands
+        if (sim->frames[frame].evicted_in != sim->replays) {
+            sim->frames[frame].evicted_in = sim->replays;
+            sim->evicted[(*num_evicted)++] = frame;
         }
     }
+    use_frame(sim, frame, time);
+    return frame;
+}
 
-    return least_used_frames; // Returns an array containing the indexes of the least used frames
+// Sequential read-ahead of a swap-in of page: the swapped-out pages right
+// after it come back with it in one request, up to swap.prefetch of them.
+// They may push out other processes' pages but never the faulting one's,
+// and do not count as faults. Returns how many were read.
+static int prefetch_pages(sim_t *sim, node_t *process, int page, int time, int *num_evicted) {
+    int *mapping = process->page_to_frame_mapping;
+    int read = 0;
+    for (int next = page + 1; read < sim->config.swap.prefetch && next < process->required_pages &&
+            mapping[next] == PAGE_EVICTED; next++) {
+        int frame = take_frame(sim, process, time, num_evicted);
+        if (frame == -1) break;
+        add_owned_frame(sim, process, frame);
+        mapping[next] = frame;
+        process->evicted_pages--;
+        sim->frames[frame].page = next;
+        sim->frames[frame].touched = 0;  // not referenced in this replay yet
+        sim->frames[frame].prefetched = 1;
+        read++;
+    }
+    sim->summary.prefetched += read;
+    return read;
 }
 
-void free_frame(int frame_number) {
-    if (frame_number >= 0 && frame_number < NUM_FRAMES) {
-        frames[frame_number].in_use = 0;  // marked as not in use
-        frames[frame_number].last_used = 0;  // reset the last used time
+// Demand paging: the process touched page and it is not resident. It goes
+// into a free frame if there is one, otherwise into a frame the policy takes
+// from any process, this one included. A page that was evicted comes back
+// from swap when the device is modelled.
+static void demand_fault(sim_t *sim, node_t *process, int page, int time, int *num_evicted) {
+    int frame = take_frame(sim, NULL, time, num_evicted);
+    if (process->frames_count == 0) {
+        process->addr = frame;
+    }
+    add_owned_frame(sim, process, frame);
+    sim->summary.page_faults++;
+    int swapped_in = process->page_to_frame_mapping[page] == PAGE_EVICTED;
+    if (swapped_in) {
+        process->evicted_pages--;
+        sim->summary.refaults++;
+    }
+    process->page_to_frame_mapping[page] = frame;
+    sim->frames[frame].page = page;
+    sim->frames[frame].touched = sim->replays;
+    if (swapped_in && sim->config.swap.enabled) {
+        process->swap_reads++;
+        process->swap_pages += 1 + prefetch_pages(sim, process, page, time, num_evicted);
     }
 }
 
-void print_and_free_evicted_frames(int time, int *evicted_frames, int num_evicted) {
-    if (num_evicted > 0) {
-        printf("%d,EVICTED,evicted-frames=[", time);
-        for (int i = 0; i < num_evicted; i++) {
-            printf("%d%s", evicted_frames[i], i < num_evicted - 1 ? "," : "");
+// Demand paging: replay the memory accesses of a process that ran for
+// run_time from time. Accesses are generated ACCESS_BATCH at a time and a
+// resident page costs one page table and one frame lookup. All of a
+// quantum's accesses happen at the same simulated time, so the replacement
+// policy sees each resident page referenced at most once per quantum, as a
+// reference bit sampled at the end of it would. Those references reach the
+// policy a batch at a time, and before any eviction so it never picks a
+// page that was just used.
+void replay_accesses(sim_t *sim, node_t *process, int time, int run_time) {
+    INSTRUMENT_DECLARE(start);
+    INSTRUMENT_START(start);
+    ensure_page_table(sim, process);
+    unsigned replay = ++sim->replays;
+    int *mapping = process->page_to_frame_mapping;
+    int pages[ACCESS_BATCH], touched[ACCESS_BATCH];
+    int num_evicted = 0;
+    long remaining = (long)run_time * sim->config.access.rate;
+    while (remaining > 0) {
+        int n = next_accesses(&sim->config.access, &process->access, process->pid, process->required_pages,
+                              pages, remaining < ACCESS_BATCH ? (int)remaining : ACCESS_BATCH);
+        if (n == 0) break;
+        int num_touched = 0;
+        for (int i = 0; i < n; i++) {
+            int frame = mapping[pages[i]];
+            if (frame >= 0) {
+                if (sim->frames[frame].touched != replay) {
+                    sim->frames[frame].touched = replay;
+                    touched[num_touched++] = frame;
+                    sim->summary.prefetch_hits += sim->frames[frame].prefetched;
+                    sim->frames[frame].prefetched = 0;
+                }
+                continue;
+            }
+            if (num_touched > 0 && sim->used_frames == sim->config.num_frames) {
+                policy_touch_batch(sim, touched, num_touched, time);
+                num_touched = 0;
+            }
+            demand_fault(sim, process, pages[i], time, &num_evicted);
         }
-        printf("]\n");
-        free(evicted_frames);
+        policy_touch_batch(sim, touched, num_touched, time);
+        sim->summary.accesses += n;
+        remaining -= n;
     }
+    INSTRUMENT_STOP(PHASE_REPLAY_ACCESSES, start);
+    print_evicted_frames(sim, time, sim->evicted, num_evicted);
 }
 
-EvictResult allocate_virtual_pages(node_t* process, int current_time) {
+// Write back the pages evicted since the last write, in one request
+static void flush_swap_writes(sim_t *sim, int time) {
+    if (sim->swap_writes == 0) return;
+    swap_transfer(&sim->swap_busy_until, &sim->config.swap, time, 1, (long)sim->swap_writes * sim->config.page_size, 1);
+    sim->summary.swap_outs += sim->swap_writes;
+    sim->swap_writes = 0;
+}
+
+// Read pages of process back from swap in reads requests issued at time,
+// after the writes of the frames they displaced. It cannot run until
+// swap_ready.
+static void swap_in(sim_t *sim, node_t *process, int reads, int pages, int time) {
+    flush_swap_writes(sim, time);
+    process->swap_ready = swap_transfer(&sim->swap_busy_until, &sim->config.swap, time, reads,
+                                        (long)pages * sim->config.page_size, 0);
+    sim->summary.swap_ins += pages;
+}
+
+// Give process the memory it needs to run its next quantum under strategy.
+// Returns 0 when the allocator cannot fit it yet. Pages it gets back from
+// swap are read before it runs: see wait_for_swap.
+int ensure_memory(sim_t *sim, node_t *process, char *strategy, int time) {
+    int allocated = 0;
     EvictResult result;
-    result.evicted_frames = calloc(NUM_FRAMES, sizeof(int));
-    result.num_evicted = 0;
-    result.success = 0;
+    long refaults = sim->summary.refaults;
+    INSTRUMENT_DECLARE(start);
 
-    int needed_pages = (process->memory + PAGE_SIZE - 1) / PAGE_SIZE;
-    if (needed_pages > NUM_FRAMES) {
-        printf("Process %s requires more pages (%d) than available frames (%d).\n", process->pid, needed_pages, NUM_FRAMES);
-        return result;
+    if (strcmp(strategy, "infinite") == 0) {
+        return 1;
+    }
+    if (is_contiguous_strategy(strategy)) {
+        if (process->addr == -1) {  // If memory not yet allocated
+            INSTRUMENT_START(start);
+            // No hole is large enough, but the holes together are
+            if (extent_largest(&sim->memory_map) < process->memory && compaction_pays(sim, process->memory, strategy)) {
+                compact_memory(sim, time);
+            }
+            process->addr = contiguous_allocate(sim, process, strategy);
+            INSTRUMENT_STOP(PHASE_CONTIGUOUS_ALLOC, start);
+            sim->allocations++;
+        }
+        allocated = 1;
+    } else if (strcmp(strategy, "paged") == 0) {
+        if (process->frames_count < process->required_pages) {  // If not every page is resident
+            INSTRUMENT_START(start);
+            result = allocate_pages(sim, process, time);
+            INSTRUMENT_STOP(PHASE_ALLOCATE_PAGES, start);
+            sim->allocations++;
+            allocated = result.success;
+            print_evicted_frames(sim, time, result.evicted_frames, result.num_evicted);
+        } else {
+            allocated = 1;
+        }
+    } else if (sim->demand) {
+        return 1;  // pages are loaded as the process touches them
+    } else if (strcmp(strategy, "virtual") == 0) {
+        INSTRUMENT_START(start);
+        result = allocate_virtual_pages(sim, process, time);
+        INSTRUMENT_STOP(PHASE_ALLOCATE_VIRTUAL, start);
+        sim->allocations++;
+        allocated = result.success;
     }
+    // The pages it got back from evictions are read from swap in one go,
+    // even if virtual memory could not give it enough to run yet
+    if (sim->summary.refaults > refaults && sim->config.swap.enabled) {
+        swap_in(sim, process, 1, (int)(sim->summary.refaults - refaults), time);
+    }
+    return process->addr != -1 && allocated;
+}
 
-    int min_required_pages = needed_pages < MIN_PAGES ? needed_pages : MIN_PAGES;
-    int allocated_pages = 0;
+// What the process needs at once and how much the strategy could ever hand
+// out right now: KB of the largest hole for the contiguous strategies, or of
+// all the holes when a compaction would pay off, and pages for the paged
+// ones, which can evict every frame not held for a process waiting on swap.
+static int memory_need(node_t *process, char *strategy) {
+    return is_contiguous_strategy(strategy) ? process->memory : process->required_pages;
+}
 
-    for (int i = 0; i < NUM_FRAMES && allocated_pages < needed_pages; i++){
-       if (frames[i].in_use && strcmp(frames[i].pid, process->pid) == 0) {
-            frames[i].last_used = current_time; // Simply update last used time if already allocated to this process
-            process->assigned_frames[allocated_pages] = i;
-            allocated_pages++;
-            continue; // Continue to the next iteration without modifying in_use or PID
-        }
+static int memory_room(sim_t *sim, char *strategy) {
+    if (strcmp(strategy, "buddy") == 0) {
+        return buddy_largest(&sim->buddy) * sim->config.page_size;
+    }
+    if (is_contiguous_strategy(strategy)) {
+        return compaction_pays(sim, 1, strategy) ? sim->memory_map.free_total : extent_largest(&sim->memory_map);
+    }
+    return sim->config.num_frames - frames_held_for_swap(sim);
+}
 
-        if (!frames[i].in_use){
-            frames[i].in_use = 1; // the frame is now in use
-            frames[i].last_used = current_time; // update the time of the frame being used.
-            strncpy(frames[i].pid, process->pid, MAX_LEN);
-            frames[i].pid[MAX_LEN] = '\0'; // 确保有 null-terminator
-            process->assigned_frames[allocated_pages] = i;
-            if (allocated_pages == 0){
-                process->addr = i;
-            }
-            allocated_pages ++;
+// Take a process whose allocation failed off the CPU until finishing
+// processes free enough memory for it; retrying it any sooner cannot succeed
+void block_on_memory(sim_t *sim, node_t *process, char *strategy) {
+    int need = memory_need(process, strategy);
+    if (sim->blocked.head == NULL || need < sim->blocked_need) {
+        sim->blocked_need = need;
+    }
+    process->state = READY;
+    insert_at_foot(&sim->blocked, process);
+}
+
+// The longest-blocked process that the memory now free could fit, taken off
+// the wait queue, or NULL. Call it until NULL after memory is released.
+node_t* wake_blocked(sim_t *sim, char *strategy) {
+    int room = memory_room(sim, strategy);
+    if (sim->blocked.head == NULL || room < sim->blocked_need) {
+        return NULL;
+    }
+    node_t *woken = NULL, *before = NULL, *prev = NULL;
+    int need = INT_MAX;
+    for (node_t *node = sim->blocked.head; node != NULL; prev = node, node = node->next) {
+        INSTRUMENT_COUNT(COUNTER_BLOCKED_SCANNED, 1);
+        int node_need = memory_need(node, strategy);
+        if (woken == NULL && node_need <= room) {
+            woken = node;
+            before = prev;
+        } else if (node_need < need) {
+            need = node_need;
         }
     }
+    sim->blocked_need = need;
+    if (woken == NULL) {
+        return NULL;
+    }
+    if (before == NULL) {
+        return remove_from_front(&sim->blocked);
+    }
+    before->next = woken->next;
+    if (sim->blocked.foot == woken) {
+        sim->blocked.foot = before;
+    }
+    woken->next = NULL;
+    sim->blocked.count--;
+    return woken;
+}
 
-    if (allocated_pages < min_required_pages) {
-        int num_frames_to_evict = min_required_pages - allocated_pages;
-        int* least_used_frames = find_least_used_frames(num_frames_to_evict);
+// Take process off rq onto sim->swapping if its reads from swap are still
+// in flight at time. Returns 1 when it has to wait.
+int wait_for_swap(sim_t *sim, runqueue_t *rq, node_t *process, int time) {
+    if (process->swap_ready <= time) return 0;
+    sim->summary.swap_wait += process->swap_ready - time;
+    process->state = SWAPPING;
+    runqueue_remove(rq, process);
+    // The device serves requests in order, so the list stays sorted by
+    // swap_ready by appending, unless reads issued since overtook a process
+    // that blocked on memory after issuing its own
+    list_t *list = &sim->swapping;
+    if (list->foot == NULL || list->foot->swap_ready <= process->swap_ready) {
+        insert_at_foot(list, process);
+        return 1;
+    }
+    node_t **link = &list->head;
+    while ((*link)->swap_ready <= process->swap_ready) {
+        link = &(*link)->next;
+    }
+    process->next = *link;
+    *link = process;
+    list->count++;
+    return 1;
+}
 
-        for (int i = 0; least_used_frames && i < num_frames_to_evict; i++) { // make sure the least_used_frames is not NULL
-            int frame_to_evict = least_used_frames[i];
-            if (frame_to_evict != -1 && frames[frame_to_evict].in_use) {
-                // found one frame to evict and free it
-                free_frame(frame_to_evict);
+// Swap I/O of the quantum process just ran, issued as it ends at time: the
+// pages evicted in the quantum are written back, then, under demand paging,
+// the pages it faulted back in are read. Those faults only come to light as
+// its accesses are replayed, and a quantum's memory work happens at once, so
+// the reads hold the process up afterwards: it cannot run again, or finish,
+// until they complete. Returns 1 when it has to wait.
+int swap_after_quantum(sim_t *sim, runqueue_t *rq, node_t *process, int time) {
+    if (!sim->config.swap.enabled) return 0;
+    flush_swap_writes(sim, time);
+    if (process->swap_reads > 0) {
+        swap_in(sim, process, process->swap_reads, process->swap_pages, time);
+        process->swap_reads = process->swap_pages = 0;
+    }
+    return wait_for_swap(sim, rq, process, time);
+}
 
-                // realloce the evicted frame to the process
-                frames[frame_to_evict].in_use = 1;
-                frames[frame_to_evict].last_used = current_time;
-                strncpy(frames[i].pid, process->pid, MAX_LEN);
-                frames[i].pid[MAX_LEN] = '\0'; 
-                process->assigned_frames[allocated_pages] = frame_to_evict;
+// The next process whose swap-ins have completed by time, taken off the
+// swap wait list, or NULL. Call it until NULL at every scheduling point.
+node_t* wake_swapped(sim_t *sim, int time) {
+    if (sim->swapping.head == NULL || sim->swapping.head->swap_ready > time) {
+        return NULL;
+    }
+    node_t *woken = remove_from_front(&sim->swapping);
+    woken->state = READY;
+    return woken;
+}
 
-                if (allocated_pages == 0) {
-                    process->addr = frame_to_evict;  // if this is the first allocation, then set the address of the process.
-                }
+// When the next process arrives or finishes waiting for swap, whichever is
+// sooner; only called while one of them is still to come
+int next_event_time(sim_t *sim, list_t *input_queue) {
+    node_t *arrival = peek_arrival(sim, input_queue);
+    if (sim->swapping.head == NULL) {
+        return arrival->arr_time;
+    }
+    int ready = sim->swapping.head->swap_ready;
+    return arrival != NULL && arrival->arr_time < ready ? arrival->arr_time : ready;
+}
 
-                allocated_pages++;
-                result.evicted_frames[result.num_evicted++] = frame_to_evict;
-            }
+// The run ended with processes that memory could never be found for
+void report_stuck(sim_t *sim) {
+    // A run cut short by a bad trace has no outcome to report
+    if (sim->input_failed) return;
+    sim->summary.stuck = sim->blocked.count;
+    if (sim->blocked.count > 0) {
+        diagnostic(sim, "All processes are stuck due to memory allocation failures.\n");
+        for (node_t *node = sim->blocked.head; node != NULL; node = node->next) {
+            diagnostic(sim, "Process %s never got its %d KB of memory.\n", node->pid, node->memory);
         }
-        print_and_free_evicted_frames(current_time, result.evicted_frames, result.num_evicted);
-        free(least_used_frames);  // free the memory of least_used_frames.
     }
-    
-    process->frames_count = allocated_pages;
-    result.success = allocated_pages >= min_required_pages;
-    
-    return result;
 }
 
-void round_robin_scheduler(list_t* input_queue, int quantum, char *strategy) {
+// RUNNING event for a process starting a run of quanta; cpu is -1 on a single CPU
+void report_running(sim_t *sim, node_t *process, char *strategy, int time, int cpu) {
+    process->state = RUNNING;
+    // Summary mode has nothing to print, so skip building the event
+    if (sim->format == FORMAT_SUMMARY) {
+        return;
+    }
+    event_t event;
+    init_event(&event, time, EVENT_RUNNING, process->pid);
+    event.cpu = cpu;
+    event.remaining_time = process->remain_time;
+    if (is_contiguous_strategy(strategy)) {
+        event.memory_kind = MEMORY_CONTIGUOUS;
+        event.address = process->addr;
+        if (strcmp(strategy, "buddy") == 0) {
+            event.mem_usage = calculate_memory_usage_buddy(sim);
+            event.internal_frag = calculate_internal_fragmentation(sim);
+        } else {
+            event.mem_usage = calculate_memory_usage_first_fit(sim, process);
+        }
+    } else if (strcmp(strategy, "paged") == 0 || strcmp(strategy, "virtual") == 0) {
+        event.memory_kind = MEMORY_PAGED;
+        event.mem_usage = calculate_memory_usage(sim);
+        sort_owned_frames(sim, process);
+        event.frames = process->assigned_frames;
+        event.frame_count = process->frames_count;
+    }
+    write_event(&sim->out, sim->format, &event);
+}
+
+// Report a process that has run to completion and hand back its memory and node
+void finish_process(sim_t *sim, node_t *process, char *strategy, int time, int proc_remaining, int cpu) {
+    event_t event;
+    init_event(&event, time, EVENT_FINISHED, process->pid);
+    event.cpu = cpu;
+    event.proc_remaining = proc_remaining;
+    write_event(&sim->out, sim->format, &event);
+    summary_add(&sim->summary, process->arr_time, process->service_time, time);
+    if (is_contiguous_strategy(strategy)) {
+        deallocate(sim, process, strategy);  // Free the allocated memory if not using infinite memory
+    } else if (strcmp(strategy, "paged") == 0 || strcmp(strategy, "virtual") == 0) {
+        release_frames(sim, process);
+    }
+    release_node(sim, process);  // Hand the node back to the pool
+}
+
+// How many whole quanta a process running alone from time can be fast-forwarded
+// by: every one of them must end before the next arrival could be admitted
+// (arrivals up to time + quantum join at the start of a quantum) and must
+// leave the process with work to do, so the finishing quantum still runs
+// through the loop. Those quanta change nothing but the clock, the process's
+// remaining time and, in paged and virtual mode, frame last-used times that
+// the next real quantum overwrites anyway. LFU counts every quantum's
+// touches instead, and demand paging has accesses to replay in every
+// quantum, so neither skips anything. Nor is the scheduling point at which
+// a process waiting for swap gets back.
+int skippable_quanta(sim_t *sim, node_t *process, list_t *input_queue, int time, int quantum) {
+    if (sim->demand || !sim->fast_forward) return 0;
+    if (sim->config.policy == POLICY_LFU && !is_contiguous_strategy(sim->strategy) && strcmp(sim->strategy, "infinite") != 0) {
+        return 0;
+    }
+    int quanta = (process->remain_time - 1) / quantum;
+    if (sim->swapping.head != NULL) {
+        int ready = sim->swapping.head->swap_ready;
+        int before_ready = ready > time ? (int)(((long)ready - time + quantum - 1) / quantum) : 0;
+        if (before_ready < quanta) {
+            quanta = before_ready;
+        }
+    }
+    if (peek_arrival(sim, input_queue) != NULL) {
+        int next_arrival = peek_arrival(sim, input_queue)->arr_time;
+        int before_arrival = next_arrival > time ? (next_arrival - time - 1) / quantum : 0;
+        if (before_arrival < quanta) {
+            quanta = before_arrival;
+        }
+    }
+    return quanta;
+}
+
+void round_robin_scheduler(sim_t *sim, list_t* input_queue, int quantum, char *strategy) {
 
     int time;
-    node_t *current = NULL, *prev = NULL;
-    list_t *ready_queue = make_empty_list();
+    node_t *current = NULL;
+    runqueue_t *ready_queue = &sim->ready_queue;
+    INSTRUMENT_DECLARE(lap);
 
-    if (input_queue->head == NULL){
-        printf("There is not any process to be excuted for now.\n");
-        return;
+    if (sim->resumed) {
+        // Pick up where the snapshot left off
+        time = sim->clock;
+    } else {
+        if (peek_arrival(sim, input_queue) == NULL){
+            if (!sim->input_failed) {
+                diagnostic(sim, "There is not any process to be excuted for now.\n");
+            }
+            return;
+        }
+        time = peek_arrival(sim, input_queue)->arr_time;
     }
 
-    time = input_queue->head->arr_time;
-    
-    while (ready_queue->head != NULL || input_queue->head != NULL) {
+    while (!sim->input_failed && (ready_queue->count > 0 || peek_arrival(sim, input_queue) != NULL || sim->swapping.head != NULL)) {
+        INSTRUMENT_LAP(PHASE_SCHEDULER_PASS, lap);
+        if (sim->snapshot_path != NULL && time >= sim->snapshot_time) {
+            take_snapshot(sim, time);
+        }
 
+        // Processes back from swap carry on, or finish if their last quantum is done
+        node_t *swapped;
+        while ((swapped = wake_swapped(sim, time)) != NULL) {
+            if (swapped->remain_time > 0) {
+                runqueue_push(ready_queue, swapped);
+                continue;
+            }
+            finish_process(sim, swapped, strategy, time, ready_queue->count + sim->blocked.count + sim->swapping.count, -1);
+            node_t *woken;
+            while ((woken = wake_blocked(sim, strategy)) != NULL) {
+                runqueue_push(ready_queue, woken);
+            }
+        }
 
         // Move processes whose arrival time has come to the ready queue
-        while (input_queue->head != NULL && input_queue->head->arr_time <= time + quantum) {
+        while (peek_arrival(sim, input_queue) != NULL && peek_arrival(sim, input_queue)->arr_time <= time + quantum) {
             node_t* process_ready = remove_from_front(input_queue);
-            insert_at_foot(ready_queue, process_ready);
+            runqueue_push(ready_queue, process_ready);
             }
+        if (sim->input_failed) {
+            break;  // Nothing after a bad record is simulated
+        }
 
-        if (ready_queue->head == NULL && input_queue->head != NULL) {
-            int arr_time = input_queue->head->arr_time;
+        if (ready_queue->count == 0 && (peek_arrival(sim, input_queue) != NULL || sim->swapping.head != NULL)) {
+            int arr_time = next_event_time(sim, input_queue);
 
             if (arr_time % quantum == 0) {
                 time = arr_time;
@@ -449,149 +1166,234 @@ void round_robin_scheduler(list_t* input_queue, int quantum, char *strategy) {
             continue;
         }
 
-        if (ready_queue->head == NULL) {
+        if (ready_queue->count == 0) {
             break;
         }
 
         // Memory management based on strategy
-        current = ready_queue->head;
-        current->required_pages = (current->memory + PAGE_SIZE - 1) / PAGE_SIZE;
-        int allocated = 0;
-        EvictResult result;
-
-        if (strcmp(strategy, "infinite") != 0) {
-            if (strcmp(strategy, "first_fit") == 0) {
-                if (current->addr == -1) {  // If memory not yet allocated
-                    current->addr = first_fit(current);
-                }
-                allocated = 1;
-            } else if (strcmp(strategy, "paged") == 0) {
-                if (current->frames_count == 0) {  // If pages not yet allocated
-                result = allocate_pages(current, time);
-                allocated = result.success;
-                print_and_free_evicted_frames(time, result.evicted_frames, result.num_evicted);
-                result.evicted_frames = NULL;
-                } else {
-                    allocated = 1;
-                }
-            } else if (strcmp(strategy, "virtual") == 0) {
-                result = allocate_virtual_pages(current,time);
-                allocated = result.success;
-            }
-
-            int failure_count = 0;
-            int length =  ready_queue_length(ready_queue);
-       
-            if (current->addr == -1 || !allocated) {  // Check if memory allocation was successful
-                failure_count++;
-
-               // if fail to allocate memory, put the process at the tail of the queue
-                if (failure_count > length) {
-                    printf("All processes are stuck due to memory allocation failures.\n");
-                    break;
-                }
-                if (current->next != NULL) {
-                    ready_queue->head = current->next;
-                    insert_at_foot(ready_queue, current);
-                }
-                continue;  // Skip this cycle as the process cannot run
-            }
-            else {
-                failure_count = 0; // reset as the allocation successes
+        current = runqueue_next(ready_queue);
+        if (!ensure_memory(sim, current, strategy, time)) {
+            // Wait for memory off the ready queue, so the rest can run
+            runqueue_remove(ready_queue, current);
+            block_on_memory(sim, current, strategy);
+            continue;
+        }
+        if (wait_for_swap(sim, ready_queue, current, time)) {
+            // It runs once the pages it got back are read in
+            if (sim->prev == current) {
+                sim->prev = NULL;
             }
+            continue;
         }
 
         // Process can now run
-        current->state = RUNNING;
-        int mem_usage = calculate_memory_usage(); // Calculate memory usage
-        while(current->pid != prev->pid){
-            if (strcmp(strategy, "infinite") == 0) {
-                printf("%d,RUNNING,process-name=%s,remaining-time=%d\n",
-                    time, current->pid, current->remain_time);
-            } else if (strcmp(strategy, "first_fit") == 0) {
-                int memory_use = calculate_memory_usage_first_fit(current);
-                printf("%d,RUNNING,process-name=%s,remaining-time=%d,mem-usage=%d%%,allocated-at=%d\n",
-                    time, current->pid, current->remain_time, memory_use, current->addr);
-            } else if (strcmp(strategy, "paged") == 0 || strcmp(strategy, "virtual") == 0) {
-                char * buffer = format_frames_list(current, current->frames_count);
-                printf("%d,RUNNING,process-name=%s,remaining-time=%d,mem-usage=%d%%,mem-frames=%s\n",
-                    time, current->pid, current->remain_time, mem_usage, buffer);
-                    free (buffer);
-            }
-            prev = current;
+        if (current != sim->prev) {
+            report_running(sim, current, strategy, time, -1);
+            sim->prev = current;
         }
         int actual_quantum = (current->remain_time > quantum) ? quantum : current->remain_time;
+        if (sim->demand) {
+            replay_accesses(sim, current, time, actual_quantum);
+        }
         current->remain_time -= actual_quantum;
-        time += quantum;  // Increment time by the quantum used
-
-        if (current->remain_time > 0) {
-            if (!current->next) {
-                continue;  // Keep running if it's the only process
+        time += quantum + sim->stall;  // Increment time by the quantum used and any compaction before it
+        sim->stall = 0;
+        sim->quanta++;
+
+        if (swap_after_quantum(sim, ready_queue, current, time)) {
+            // Off the CPU until its pages are back from swap
+            sim->prev = NULL;
+        } else if (current->remain_time > 0) {
+            runqueue_ran(ready_queue, current);
+            if (ready_queue->count == 1) {
+                // Keep running if it's the only process. Nothing is printed
+                // until a new arrival joins or the process is about to finish,
+                // so jump straight over the quanta in between.
+                int quanta = skippable_quanta(sim, current, input_queue, time, quantum);
+                current->remain_time -= quanta * quantum;
+                time += quanta * quantum;
+                sim->quanta += quanta;
+                runqueue_advance(ready_queue, current, quanta);
             }
-            // Move to end
-            ready_queue->head = current->next;
-            insert_at_foot(ready_queue, current);
         }
         else if (current->remain_time < quantum){
             // Process completes
-            int length = ready_queue_length(ready_queue);
-            printf("%d,FINISHED,process-name=%s,proc-remaining=%d\n", time, current->pid, length - 1 );
-            ready_queue->head = current->next;
-            if (strcmp(strategy, "first_fit") == 0 || strcmp(strategy, "paged") == 0 || strcmp(strategy, "virtual") == 0) {
-                deallocate(current);  // Free the allocated memory if not using infinite memory
+            int length = ready_queue->count;
+            runqueue_remove(ready_queue, current);
+            // Processes waiting for memory are still in the system, so they count too
+            finish_process(sim, current, strategy, time, length - 1 + sim->blocked.count + sim->swapping.count, -1);
+            sim->prev = NULL;
+            node_t *woken;
+            while ((woken = wake_blocked(sim, strategy)) != NULL) {
+                runqueue_push(ready_queue, woken);
             }
-            free(current);  // Free the node
         }
     }
+    report_stuck(sim);
 }
 
-
-
-int main(int argc, char **argv) {
-
-    // if the input parameters correct
-    if (argc != 7) {
-        printf("Invalid input!\n");
-        return 0;
+int init_config(sim_config_t *config, int memory_kb, int page_size, int min_pages) {
+    // A page table holds two ints per page, indexed with int
+    if (memory_kb <= 0 || page_size <= 0 || page_size > memory_kb || min_pages <= 0
+        || memory_kb / page_size > INT_MAX / 2) {
+        return -1;
+    }
+    config->memory_kb = memory_kb;
+    config->page_size = page_size;
+    config->min_pages = min_pages;
+    config->num_frames = memory_kb / page_size;
+    config->frame_words = (config->num_frames + 63) / 64;
+    config->policy = POLICY_LRU;
+    config->ws_window = WS_WINDOW;
+    config->cpus = 1;
+    config->scheduler = SCHEDULER_RR;
+    access_model_init(&config->access);
+    config->compact_threshold = -1;
+    config->compact_cost = COMPACT_COST;
+    swap_config_init(&config->swap);
+    config->page_shift = -1;
+    if ((page_size & (page_size - 1)) == 0) {
+        config->page_shift = __builtin_ctz(page_size);
     }
+    return 0;
+}
 
-    char* filename = NULL;
-    int quantum = 0;
-    char* strategy = NULL;
+// "<n>" or "<n>K" is KB, "<n>M" and "<n>G" are MB and GB; -1 when malformed or too big
+int parse_size_kb(const char *text) {
+    char *end;
+    long long value = strtoll(text, &end, 10);
+    if (end == text || value <= 0) return -1;
+    if (*end == 'M' || *end == 'm') {
+        value <<= 10;
+        end++;
+    } else if (*end == 'G' || *end == 'g') {
+        value <<= 20;
+        end++;
+    } else if (*end == 'K' || *end == 'k') {
+        end++;
+    }
+    if (*end != '\0' || value > INT_MAX) return -1;
+    return (int)value;
+}
 
-    for (int i = 1; i < argc; i += 2) {
-        if (strcmp(argv[i], "-f") == 0) {
-            filename = argv[i + 1];
-        } else if (strcmp(argv[i], "-q") == 0) {
-            quantum = atoi(argv[i + 1]);
-        } else if (strcmp(argv[i], "-m") == 0) {
-            strategy = argv[i + 1];
+void sim_init(sim_t *sim, const sim_config_t *config, int out_fd) {
+    sim->config = *config;
+    sim->frames = alloc_or_die(config->num_frames * sizeof(Frame));
+    sim->frame_bitmap = alloc_or_die(config->frame_words * sizeof(uint64_t));
+    sim->evicted = alloc_or_die(config->num_frames * sizeof(int));
+    output_init(&sim->out, out_fd);
+    sim->format = FORMAT_TEXT;
+    summary_init(&sim->summary);
+    sim->trace = NULL;
+    sim->trace_pos = 0;
+    sim->input_feed = NULL;
+    sim->input_failed = 0;
+    sim->quanta = 0;
+    sim->fast_forward = 1;
+    sim->allocations = 0;
+    sim->arrivals = 0;
+    sim->blocked.head = sim->blocked.foot = NULL;
+    sim->blocked.count = 0;
+    sim->blocked_need = 0;
+    sim->cpus = NULL;
+    sim->cpu_span = 0;
+    sim->input_queue.head = sim->input_queue.foot = NULL;
+    sim->input_queue.count = 0;
+    runqueue_init(&sim->ready_queue, config->scheduler);
+    sim->prev = NULL;
+    sim->clock = sim->clock_start = 0;
+    sim->resumed = 0;
+    sim->quantum = 0;
+    sim->strategy[0] = '\0';
+    sim->snapshot_path = NULL;
+    sim->snapshot_time = 0;
+    sim->snapshot_failed = 0;
+    sim->demand = 0;
+    sim->replays = 0;
+    sim->stall = 0;
+    sim->swapping.head = sim->swapping.foot = NULL;
+    sim->swapping.count = 0;
+    sim->swap_busy_until = 0;
+    sim->swap_writes = 0;
+    if (config->cpus > 1) {
+        sim->cpus = alloc_or_die(config->cpus * sizeof(cpu_t));
+        for (int i = 0; i < config->cpus; i++) {
+            runqueue_init(&sim->cpus[i].queue, config->scheduler);
+            sim->cpus[i].prev = NULL;
+            sim->cpus[i].current = NULL;
+            sim->cpus[i].busy = 0;
+            sim->cpus[i].migrations = 0;
         }
     }
+    sim->process_table.nodes = NULL;
+    sim->process_table.free_ids = NULL;
+    sim->process_table.count = sim->process_table.capacity = sim->process_table.free_count = 0;
+    initialize_node_pool(sim);
+    initialize_memory(sim);
+    initialize_frames(sim);
+    policy_init(sim);
+}
 
-    if (filename == NULL || strategy == NULL || quantum <= 0) {
-        fprintf(stderr, "Invalid arguments\n");
-        return 1;
+void sim_destroy(sim_t *sim) {
+    output_destroy(&sim->out);
+    free(sim->frames);
+    free(sim->frame_bitmap);
+    free(sim->evicted);
+    runqueue_destroy(&sim->ready_queue);
+    if (sim->cpus) {
+        for (int i = 0; i < sim->config.cpus; i++) {
+            runqueue_destroy(&sim->cpus[i].queue);
+        }
+        free(sim->cpus);
     }
-
-    list_t *input_queue = make_empty_list();
-    read_input(input_queue, filename);
-    
-    if (strcmp(strategy, "infinite") == 0) {
-        round_robin_scheduler(input_queue, quantum, "infinite");
-    } else if (strcmp(strategy, "first_fit") == 0) {
-        round_robin_scheduler(input_queue, quantum, "first_fit");
-    } else if (strcmp(strategy, "paged") == 0) {
-        round_robin_scheduler(input_queue, quantum, "paged");
-    } else if (strcmp(strategy, "virtual") == 0) {
-        round_robin_scheduler(input_queue, quantum, "virtual");
+    policy_destroy(sim);
+    destroy_process_table(sim);
+    destroy_node_pool(sim);
+    extent_map_destroy(&sim->memory_map);
+    if (sim->buddy.units > 0) {
+        buddy_destroy(&sim->buddy);
     }
-    else {
+}
+
+// Run one simulation over sim->trace or sim->input_feed
+int run_simulation(sim_t *sim, int quantum, char *strategy) {
+    if (!is_valid_strategy(strategy)) {
         fprintf(stderr, "Unsupported memory strategy\n");
-        return 1;
+        return -1;
+    }
+    if (sim->resumed && (quantum != sim->quantum || strcmp(strategy, sim->strategy) != 0)) {
+        fprintf(stderr, "Snapshot was taken with -q %d -m %s\n", sim->quantum, sim->strategy);
+        return -1;
+    }
+    sim->quantum = quantum;
+    snprintf(sim->strategy, sizeof(sim->strategy), "%s", strategy);
+    sim->demand = sim->config.access.kind != ACCESS_NONE && strcmp(strategy, "virtual") == 0;
+    begin_event_stream(&sim->out, sim->format);
+    if (sim->cpus) {
+        multi_cpu_scheduler(sim, &sim->input_queue, quantum, strategy);
+    } else {
+        round_robin_scheduler(sim, &sim->input_queue, quantum, strategy);
+    }
+    if (sim->input_failed) {
+        // The events up to the bad record are kept, but no summary
+        output_flush(&sim->out);
+        return -1;
+    }
+    if (sim->snapshot_path != NULL) {
+        fprintf(stderr, "Simulation ended before time %d, no snapshot written\n", sim->snapshot_time);
+        sim->snapshot_failed = 1;
+    }
+    if (sim->format == FORMAT_SUMMARY) {
+        write_summary(&sim->out, &sim->summary);
+    }
+    // Per-CPU figures only fit the line-oriented formats
+    if (sim->cpus && (sim->format == FORMAT_TEXT || sim->format == FORMAT_SUMMARY)) {
+        for (int i = 0; i < sim->config.cpus; i++) {
+            write_cpu_stats(&sim->out, i, sim->cpus[i].busy, sim->cpu_span, sim->cpus[i].migrations);
+        }
+    }
+    if (output_flush(&sim->out) != 0 || sim->snapshot_failed) {
+        return -1;
     }
-
-    free_list(input_queue);;
     return 0;
 }
-
@@ -1,46 +1,176 @@
 #ifndef MEMORY_MANAGEMENT_H
 #define MEMORY_MANAGEMENT_H
 
-#define MAX_LEN 8
-#define MAX_MEMORY 2048  // Total memory size in KB
+#include <stdint.h>
+#include "access.h"
+#include "buddy.h"
+#include "extent_alloc.h"
+#include "events.h"
+#include "instrument.h"
+#include "output.h"
+#include "pool.h"
+#include "replacement.h"
+#include "scheduler.h"
+#include "swap.h"
+#include "trace.h"
+#include "feed.h"
+
+#define MAX_MEMORY 2048  // Default total memory size in KB
 #define QUANTUM 1  // Quantum time in seconds
-#define PAGE_SIZE 4  // 4KB per page
-#define NUM_FRAMES (MAX_MEMORY / PAGE_SIZE)  // frame number
-#define MAX_FRAMES_PER_PROCESS 2048
-#define MIN_PAGES 4 // the minimum pages that needed in virtual memory allocation algorithm
+#define PAGE_SIZE 4  // Default page size, 4KB per page
+#define MIN_PAGES 4 // the minimum pages that needed in virtual memory allocation algorithm, by default
+#define MAX_CPUS 1024  // most CPUs a run can simulate
+#define MAX_STRATEGY_LEN 15  // longest memory strategy name
+#define COMPACT_COST 1  // default simulated time per MB moved by a compaction
+#define PAGE_EVICTED -2  // page_to_frame_mapping entry of a page lost to eviction; -1 is never loaded
 
-typedef enum { READY, RUNNING, FINISHED } State;
+typedef enum { READY, RUNNING, FINISHED, SWAPPING } State;
 
 typedef struct node {
     char pid[MAX_LEN + 1];
     int arr_time;
     int remain_time;
+    int service_time;  // run time from the trace
     int memory;  // Memory requirement in KB
     int addr;  // Starting address of the allocated memory
-    int page_to_frame_mapping[MAX_FRAMES_PER_PROCESS];
+    int *page_to_frame_mapping;  // required_pages entries, carved from node_pool on first use; filled in under demand paging
     int num_pages;  // Total pages required by the process
     State state;
-    int assigned_frames[MAX_FRAMES_PER_PROCESS];  // Array to hold frame indices
+    int *assigned_frames;  // Array to hold frame indices, sized like page_to_frame_mapping
     int frames_count;  // Number of frames allocated
     int required_pages;  // pages that the process need
     struct node *next;
     int isValid;
+    int id;  // index in process_table while the process has a page table, otherwise -1
+    int evicted_pages;  // pages lost to evictions and not yet faulted back in
+    int cpu;  // CPU whose run queue holds the process in multi-CPU runs, otherwise -1
+    long seq;  // arrival order, breaks ties between equally short processes
+    int level;  // MLFQ: priority level, 0 highest
+    int slice_used;  // MLFQ: quanta run at the current level
+    int heap_index;  // SRTF: position in the run queue's heap
+    access_state_t access;  // demand paging: where it is in its memory accesses
+    int swap_reads;  // swap-in requests made in the current quantum, issued as it ends
+    int swap_pages;  // pages they read
+    int swap_ready;  // time its latest swap-in completes
 } node_t;
 
-int memory[MAX_MEMORY] = {0};  // Memory blocks
+typedef struct {
+    node_t **nodes;  // id -> process, NULL for unused ids
+    int *free_ids;  // ids released by finished processes
+    int count;  // ids handed out so far
+    int free_count;
+    int capacity;
+} process_table_t;
 
 typedef struct {
     node_t *head;
     node_t *foot;
+    int count;  // number of nodes, kept by insert_at_foot and remove_from_front
 } list_t;
 
+// Ready processes in the order the scheduler picks them. Round robin uses
+// levels[0]; MLFQ one list per level with a bit per non-empty level in
+// level_mask; SRTF a binary min-heap on (remain_time, seq).
+typedef struct {
+    scheduler_t scheduler;
+    int count;  // processes queued
+    list_t levels[MLFQ_LEVELS];
+    unsigned level_mask;
+    int boost_in;  // MLFQ: quanta left until the next priority boost
+    node_t **heap;
+    int heap_count;
+    int heap_capacity;
+} runqueue_t;
+
+// One simulated CPU of a multi-CPU run
+typedef struct {
+    runqueue_t queue;  // its run queue
+    node_t *prev;  // process that ran on it in the previous quantum
+    node_t *current;  // process running in this quantum, NULL while idle
+    long busy;  // time spent running processes
+    long migrations;  // processes it stole from other CPUs
+} cpu_t;
+
 typedef struct {
-    int in_use;  // if the frame is in use，0 for free，1 for in use
     int last_used;  // the last used time based on LRU
-    char pid[MAX_LEN + 1];  // The ID of the process that occupies the frame, used for tracing and debugging
+    int referenced;  // reference bit for CLOCK and the working set
+    int bucket;  // LFU bucket holding the frame
+    int owner;  // process_table id of the process holding the frame, -1 when free
+    int owner_slot;  // position of the frame in its owner's assigned_frames
+    int lru_prev;  // neighbours in the LRU list (or LFU bucket) of in-use frames, -1 at either end
+    int lru_next;
+    int page;  // demand paging: page of the owner held in the frame, otherwise -1
+    unsigned touched;  // demand paging: replay that last referenced the frame
+    unsigned evicted_in;  // demand paging: replay that last evicted it
+    int prefetched;  // demand paging: read ahead from swap and not referenced since
 } Frame;
 
-Frame frames[NUM_FRAMES];  // the total frame number
+// Memory geometry of a run, set from the command line
+typedef struct {
+    int memory_kb;  // total memory in KB
+    int page_size;  // KB per page
+    int min_pages;  // resident pages a process needs to run under virtual
+    int num_frames;  // memory_kb / page_size
+    int frame_words;  // 64-bit words in the frame bitmap
+    int page_shift;  // log2(page_size) when it is a power of two, otherwise -1
+    replacement_policy_t policy;  // who gets evicted under paged and virtual
+    int ws_window;  // working-set window in simulated seconds
+    int cpus;  // simulated CPUs, each with its own run queue
+    scheduler_t scheduler;  // how each run queue orders its processes
+    access_model_t access;  // pages virtual processes touch, when it pages on demand
+    int compact_threshold;  // compact when this percent of free memory lies outside the largest hole, -1 never
+    int compact_cost;  // simulated time per MB a compaction moves, rounded up
+    swap_config_t swap;  // device evicted pages are written to and read back from
+} sim_config_t;
+
+// Everything one simulation run owns, so several runs can share a process
+typedef struct {
+    sim_config_t config;
+    output_t out;  // where the event log goes
+    event_format_t format;  // how events are written to out
+    summary_t summary;  // metrics of the processes finished so far
+    const trace_t *trace;  // loaded trace feeding the input queue, if any; never modified
+    long trace_pos;  // records of the trace or input_feed handed out so far
+    trace_feed_t *input_feed;  // Trace parsed on another thread feeding the input queue, if any
+    int input_failed;  // input_feed reached a bad record, so the run stops there
+    process_table_t process_table;  // Owners of frames, indexed by Frame.owner
+    pool_t node_pool;  // Backing store for every node_t and its page table
+    extent_map_t memory_map;  // Free holes of the contiguous memory
+    buddy_t buddy;  // Free blocks of the buddy strategy, in pages; set up on first use
+    long buddy_requested;  // KB asked for by the processes holding buddy blocks
+    Frame *frames;  // config.num_frames frames
+    uint64_t *frame_bitmap;  // bit i set when frame i is in use
+    int used_frames;  // bits set in frame_bitmap
+    int *evicted;  // frames evicted by the latest allocation
+    int lru_head;  // in-use frame with the oldest (last_used, index)
+    int lru_tail;  // in-use frame with the newest (last_used, index)
+    replacement_t replacement;  // state of the other policies
+    long quanta;  // quanta simulated so far, fast-forwarded ones included
+    int fast_forward;  // skip quanta that change nothing but the clock; bench -V turns it off
+    long allocations;  // calls into the strategy's allocator
+    long arrivals;  // processes created so far
+    list_t blocked;  // processes waiting for memory, in the order they blocked
+    int blocked_need;  // least memory_need of a blocked process
+    cpu_t *cpus;  // config.cpus CPUs when there is more than one, otherwise NULL
+    int cpu_span;  // time from the first arrival to the end of a multi-CPU run
+    list_t input_queue;  // arrivals read from the trace but not yet admitted
+    runqueue_t ready_queue;  // run queue of a single-CPU run
+    node_t *prev;  // process that ran in the previous quantum of a single-CPU run
+    int clock;  // simulated time the run resumes from
+    int clock_start;  // time of the first arrival
+    int resumed;  // state was loaded from a snapshot rather than built from scratch
+    int quantum;  // quantum and strategy of the run, kept for snapshots
+    char strategy[MAX_STRATEGY_LEN + 1];
+    const char *snapshot_path;  // where to write a snapshot, NULL once written or if none is wanted
+    int snapshot_time;  // write it at the first scheduling point at or after this time
+    int snapshot_failed;
+    int demand;  // virtual with an access model: pages are loaded as they are touched
+    unsigned replays;  // access replays so far, for Frame.touched and evicted_in
+    int stall;  // time compactions charged to the current quantum
+    list_t swapping;  // processes waiting for swap-ins, by the time those complete
+    int swap_busy_until;  // time the swap device finishes the requests queued so far
+    int swap_writes;  // pages evicted in the current quantum, written back as it ends
+} sim_t;
 
 typedef struct EvictResult {
     int* evicted_frames;
@@ -48,25 +178,89 @@ typedef struct EvictResult {
     int success;
 } EvictResult;
 
-void initialize_frames();
+int init_config(sim_config_t *config, int memory_kb, int page_size, int min_pages);
+int parse_size_kb(const char *text);
+void sim_init(sim_t *sim, const sim_config_t *config, int out_fd);
+void sim_destroy(sim_t *sim);
+int run_simulation(sim_t *sim, int quantum, char *strategy);
+void initialize_frames(sim_t *sim);
+void initialize_memory(sim_t *sim);
 list_t* make_empty_list(void);
 void insert_at_foot(list_t* list, node_t* new_node);
 node_t* remove_from_front(list_t* list);
-node_t* create_node(char* pid, int arr_time, int remain_time, int memory);
-void read_input(list_t* input_queue, char* filename);
-int first_fit(node_t *node);
-void deallocate(node_t *node);
-int calculate_memory_usage_first_fit(node_t *node);
-int evict_page_paged(int current_time);
-int* find_least_used_frames(int frames_to_evict);
-EvictResult allocate_pages(node_t* process, int current_time);
-EvictResult allocate_virtual_pages(node_t* process, int current_time);
-void round_robin_scheduler(list_t* ready_queue, int quantum, char *strategy);
+void initialize_node_pool(sim_t *sim);
+void destroy_node_pool(sim_t *sim);
+node_t* create_node(sim_t *sim, const char* pid, int arr_time, int remain_time, int memory);
+void ensure_page_table(sim_t *sim, node_t *node);
+void release_node(sim_t *sim, node_t *node);
+node_t* peek_arrival(sim_t *sim, list_t* input_queue);
+int first_fit(sim_t *sim, node_t *node);
+int best_fit(sim_t *sim, node_t *node);
+int next_fit(sim_t *sim, node_t *node);
+int buddy_fit(sim_t *sim, node_t *node);
+int contiguous_allocate(sim_t *sim, node_t *node, char *strategy);
+int is_contiguous_strategy(char *strategy);
+void deallocate(sim_t *sim, node_t *node, char *strategy);
+int calculate_memory_usage_first_fit(sim_t *sim, node_t *node);
+int calculate_memory_usage_buddy(sim_t *sim);
+int calculate_internal_fragmentation(sim_t *sim);
+int external_fragmentation(sim_t *sim);
+int compact_memory(sim_t *sim, int time);
+int evict_page_paged(sim_t *sim, node_t *process, int current_time);
+EvictResult allocate_pages(sim_t *sim, node_t* process, int current_time);
+EvictResult allocate_virtual_pages(sim_t *sim, node_t* process, int current_time);
+void replay_accesses(sim_t *sim, node_t *process, int time, int run_time);
+int skippable_quanta(sim_t *sim, node_t *process, list_t *input_queue, int time, int quantum);
+void round_robin_scheduler(sim_t *sim, list_t* input_queue, int quantum, char *strategy);
+void multi_cpu_scheduler(sim_t *sim, list_t* input_queue, int quantum, char *strategy);
+int ensure_memory(sim_t *sim, node_t *process, char *strategy, int time);
+void block_on_memory(sim_t *sim, node_t *process, char *strategy);
+int wait_for_swap(sim_t *sim, runqueue_t *rq, node_t *process, int time);
+int swap_after_quantum(sim_t *sim, runqueue_t *rq, node_t *process, int time);
+node_t* wake_swapped(sim_t *sim, int time);
+int next_event_time(sim_t *sim, list_t *input_queue);
+node_t* wake_blocked(sim_t *sim, char *strategy);
+void report_stuck(sim_t *sim);
+void report_running(sim_t *sim, node_t *process, char *strategy, int time, int cpu);
+void finish_process(sim_t *sim, node_t *process, char *strategy, int time, int proc_remaining, int cpu);
+void diagnostic(sim_t *sim, const char *format, ...);
+void take_snapshot(sim_t *sim, int time);
 void free_list(list_t *list);
-int calculate_memory_usage();
-int find_free_frame();
-char* format_frames_list(node_t *node, int count);
+void register_process(sim_t *sim, node_t *node);
+void unregister_process(sim_t *sim, node_t *node);
+void destroy_process_table(sim_t *sim);
+void free_frame(sim_t *sim, int frame_number);
+void release_frames(sim_t *sim, node_t *process);
+int calculate_memory_usage(sim_t *sim);
+void print_evicted_frames(sim_t *sim, int time, int *evicted_frames, int num_evicted);
+int frame_in_use(sim_t *sim, int frame_number);
+void mark_frame_used(sim_t *sim, int frame_number);
+void mark_frame_free(sim_t *sim, int frame_number);
+int find_free_frame(sim_t *sim);
+void lru_insert(sim_t *sim, int frame_number);
+void lru_remove(sim_t *sim, int frame_number);
+void lru_touch(sim_t *sim, int frame_number, int current_time);
+void policy_init(sim_t *sim);
+void policy_destroy(sim_t *sim);
+void policy_insert(sim_t *sim, int frame_number, int current_time);
+void policy_touch(sim_t *sim, int frame_number, int current_time);
+void policy_touch_batch(sim_t *sim, int *frames, int count, int current_time);
+void policy_insert_batch(sim_t *sim, int *frames, int count, int current_time);
+void policy_remove(sim_t *sim, int frame_number);
+int policy_victim(sim_t *sim, node_t *requester, int current_time);
+void runqueue_init(runqueue_t *rq, scheduler_t scheduler);
+void runqueue_destroy(runqueue_t *rq);
+void runqueue_push(runqueue_t *rq, node_t *node);
+node_t* runqueue_next(runqueue_t *rq);
+void runqueue_ran(runqueue_t *rq, node_t *node);
+void runqueue_advance(runqueue_t *rq, node_t *node, int quanta);
+void runqueue_remove(runqueue_t *rq, node_t *node);
+node_t* runqueue_steal(runqueue_t *rq);
+void runqueue_walk(runqueue_t *rq, void (*visit)(void *context, node_t *node), void *context);
+void runqueue_restore(runqueue_t *rq, node_t *node);
+void sort_owned_frames(sim_t *sim, node_t *node);
 int ready_queue_length(list_t *list);
 int isValidNode(node_t* node);
+int is_valid_strategy(char *strategy);
 
 #endif // MEMORY_MANAGEMENT_H
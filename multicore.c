@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include "memory_management.h"
+
+// Shortest run queue, lowest numbered CPU on ties
+static int least_loaded_cpu(sim_t *sim) {
+    int best = 0;
+    for (int i = 1; i < sim->config.cpus; i++) {
+        if (sim->cpus[i].queue.count < sim->cpus[best].queue.count) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Busiest CPU with a process waiting behind the one at its head, or -1
+static int steal_victim(sim_t *sim) {
+    int victim = -1;
+    for (int i = 0; i < sim->config.cpus; i++) {
+        int count = sim->cpus[i].queue.count;
+        if (count >= 2 && (victim == -1 || count > sim->cpus[victim].queue.count)) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+// Take a process the CPU would not run next
+static node_t* steal_from(cpu_t *cpu) {
+    node_t *stolen = runqueue_steal(&cpu->queue);
+    if (cpu->prev == stolen) {
+        cpu->prev = NULL;
+    }
+    return stolen;
+}
+
+// Every CPU with an empty run queue steals one process from the busiest CPU
+static void balance_cpus(sim_t *sim) {
+    for (int i = 0; i < sim->config.cpus; i++) {
+        if (sim->cpus[i].queue.count > 0) continue;
+        int victim = steal_victim(sim);
+        if (victim == -1) return;
+        node_t *stolen = steal_from(&sim->cpus[victim]);
+        stolen->cpu = i;
+        runqueue_push(&sim->cpus[i].queue, stolen);
+        sim->cpus[i].migrations++;
+    }
+}
+
+// The first process in scheduling order on cpu that memory can be found
+// for. Those that cannot be fitted go to wait for memory, and those that
+// got pages back wait for swap to read them.
+static node_t* pick_runnable(sim_t *sim, cpu_t *cpu, char *strategy, int time, int *ready) {
+    runqueue_t *queue = &cpu->queue;
+    node_t *next;
+    while ((next = runqueue_next(queue)) != NULL) {
+        int fits = ensure_memory(sim, next, strategy, time);
+        if (fits && !wait_for_swap(sim, queue, next, time)) {
+            return next;
+        }
+        if (cpu->prev == next) {
+            cpu->prev = NULL;
+        }
+        if (!fits) {
+            runqueue_remove(queue, next);
+            block_on_memory(sim, next, strategy);
+        }
+        (*ready)--;
+    }
+    return NULL;
+}
+
+static int next_quantum_boundary(int time, int quantum) {
+    return time % quantum == 0 ? time : time + (quantum - time % quantum);
+}
+
+// Scheduling on sim->config.cpus CPUs sharing one memory. CPUs act in index
+// order within every quantum, so a run always gives the same event order:
+// arrivals join the shortest run queue, idle CPUs steal, each CPU runs the
+// next process of its queue, then finished processes leave in CPU order.
+void multi_cpu_scheduler(sim_t *sim, list_t* input_queue, int quantum, char *strategy) {
+    int cpus = sim->config.cpus;
+    int ready = 0;  // processes in all run queues
+    int time;
+    INSTRUMENT_DECLARE(lap);
+
+    if (sim->resumed) {
+        // Pick up where the snapshot left off
+        time = sim->clock;
+        for (int c = 0; c < cpus; c++) {
+            ready += sim->cpus[c].queue.count;
+        }
+    } else {
+        if (peek_arrival(sim, input_queue) == NULL) {
+            if (!sim->input_failed) {
+                diagnostic(sim, "There is not any process to be excuted for now.\n");
+            }
+            return;
+        }
+        time = sim->clock_start = peek_arrival(sim, input_queue)->arr_time;
+    }
+
+    while (!sim->input_failed && (ready > 0 || peek_arrival(sim, input_queue) != NULL || sim->swapping.head != NULL)) {
+        INSTRUMENT_LAP(PHASE_SCHEDULER_PASS, lap);
+        if (sim->snapshot_path != NULL && time >= sim->snapshot_time) {
+            take_snapshot(sim, time);
+        }
+        // Processes back from swap join the shortest queue, or finish on
+        // the CPU they last ran on if their last quantum is done
+        node_t *swapped;
+        while ((swapped = wake_swapped(sim, time)) != NULL) {
+            if (swapped->remain_time > 0) {
+                swapped->cpu = least_loaded_cpu(sim);
+                runqueue_push(&sim->cpus[swapped->cpu].queue, swapped);
+                ready++;
+                continue;
+            }
+            finish_process(sim, swapped, strategy, time, ready + sim->blocked.count + sim->swapping.count, swapped->cpu);
+            node_t *woken;
+            while ((woken = wake_blocked(sim, strategy)) != NULL) {
+                woken->cpu = least_loaded_cpu(sim);
+                runqueue_push(&sim->cpus[woken->cpu].queue, woken);
+                ready++;
+            }
+        }
+        while (peek_arrival(sim, input_queue) != NULL && peek_arrival(sim, input_queue)->arr_time <= time + quantum) {
+            node_t *process = remove_from_front(input_queue);
+            process->cpu = least_loaded_cpu(sim);
+            runqueue_push(&sim->cpus[process->cpu].queue, process);
+            ready++;
+        }
+        if (sim->input_failed) {
+            break;  // Nothing after a bad record is simulated
+        }
+
+        if (ready == 0) {
+            if (peek_arrival(sim, input_queue) == NULL && sim->swapping.head == NULL) {
+                break;  // The last process finished as it came back from swap
+            }
+            time = next_quantum_boundary(next_event_time(sim, input_queue), quantum);
+            continue;
+        }
+
+        balance_cpus(sim);
+
+        int running = 0;
+        for (int c = 0; c < cpus; c++) {
+            cpu_t *cpu = &sim->cpus[c];
+            node_t *current = pick_runnable(sim, cpu, strategy, time, &ready);
+            cpu->current = current;
+            if (current == NULL) continue;
+            if (current != cpu->prev) {
+                report_running(sim, current, strategy, time, c);
+                cpu->prev = current;
+            }
+            int actual_quantum = (current->remain_time > quantum) ? quantum : current->remain_time;
+            if (sim->demand) {
+                replay_accesses(sim, current, time, actual_quantum);
+            }
+            current->remain_time -= actual_quantum;
+            cpu->busy += actual_quantum;
+            running++;
+        }
+        time += quantum + sim->stall;  // compactions stall every CPU
+        sim->stall = 0;
+        sim->quanta += running;
+
+        if (running == 0) {
+            // Every ready process blocked on memory, and only an arrival can run now
+            if (peek_arrival(sim, input_queue) != NULL) {
+                int next = next_quantum_boundary(peek_arrival(sim, input_queue)->arr_time, quantum);
+                if (next > time) {
+                    time = next;
+                }
+            }
+            continue;
+        }
+
+        int departed = 0;  // processes that finished or went to wait for swap
+        for (int c = 0; c < cpus; c++) {
+            cpu_t *cpu = &sim->cpus[c];
+            node_t *current = cpu->current;
+            if (current == NULL) continue;
+            if (swap_after_quantum(sim, &cpu->queue, current, time)) {
+                // Off the CPU until its pages are back from swap
+                ready--;
+                cpu->current = NULL;
+                cpu->prev = NULL;
+                departed++;
+            } else if (current->remain_time > 0) {
+                runqueue_ran(&cpu->queue, current);
+            } else {
+                runqueue_remove(&cpu->queue, current);
+                ready--;
+                finish_process(sim, current, strategy, time, ready + sim->blocked.count + sim->swapping.count, c);
+                cpu->current = NULL;
+                cpu->prev = NULL;
+                departed++;
+            }
+        }
+        node_t *woken;
+        while ((woken = wake_blocked(sim, strategy)) != NULL) {
+            woken->cpu = least_loaded_cpu(sim);
+            runqueue_push(&sim->cpus[woken->cpu].queue, woken);
+            ready++;
+        }
+
+        // Once every CPU is left running a lone process, nothing is printed
+        // until one of them is about to finish or a new arrival joins, so
+        // jump over the quanta in between as the single-CPU scheduler does.
+        // Processes running side by side in paged or virtual memory take
+        // frames from each other every quantum, so there nothing is skipped
+        // unless one CPU is busy.
+        int shares_frames = strcmp(strategy, "paged") == 0 || strcmp(strategy, "virtual") == 0;
+        if (departed == 0 && ready == running && (running == 1 || !shares_frames)) {
+            int quanta = -1;
+            for (int c = 0; c < cpus; c++) {
+                node_t *current = sim->cpus[c].current;
+                if (current == NULL) continue;
+                int skippable = skippable_quanta(sim, current, input_queue, time, quantum);
+                if (quanta == -1 || skippable < quanta) {
+                    quanta = skippable;
+                }
+            }
+            for (int c = 0; c < cpus; c++) {
+                node_t *current = sim->cpus[c].current;
+                if (current == NULL) continue;
+                current->remain_time -= quanta * quantum;
+                sim->cpus[c].busy += (long)quanta * quantum;
+                runqueue_advance(&sim->cpus[c].queue, current, quanta);
+            }
+            time += quanta * quantum;
+            sim->quanta += (long)quanta * running;
+        }
+    }
+    report_stuck(sim);
+    sim->cpu_span = time - sim->clock_start;
+}
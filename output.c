@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include "output.h"
+
+#define OUTPUT_MAX_INT 24  // room for any long with its sign
+
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void output_init(output_t *out, int fd) {
+    out->fd = fd;
+    out->len = 0;
+    out->failed = 0;
+    out->buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (!out->buffer) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+}
+
+// Write out everything buffered so far; -1 once any write has failed
+int output_flush(output_t *out) {
+    size_t done = 0;
+    while (out->fd != OUTPUT_DISCARD && !out->failed && done < out->len) {
+        ssize_t n = write(out->fd, out->buffer + done, out->len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "Failed to write output\n");
+            out->failed = 1;
+            break;
+        }
+        done += n;
+    }
+    out->len = 0;
+    return out->failed ? -1 : 0;
+}
+
+void output_destroy(output_t *out) {
+    output_flush(out);
+    free(out->buffer);
+    out->buffer = NULL;
+}
+
+// make sure n more bytes fit, flushing if they don't
+static void reserve(output_t *out, size_t n) {
+    if (out->len + n > OUTPUT_BUFFER_SIZE) {
+        output_flush(out);
+    }
+}
+
+void output_bytes(output_t *out, const char *s, size_t n) {
+    while (out->len + n > OUTPUT_BUFFER_SIZE) {
+        size_t part = OUTPUT_BUFFER_SIZE - out->len;
+        memcpy(out->buffer + out->len, s, part);
+        out->len += part;
+        s += part;
+        n -= part;
+        output_flush(out);
+    }
+    memcpy(out->buffer + out->len, s, n);
+    out->len += n;
+}
+
+void output_str(output_t *out, const char *s) {
+    output_bytes(out, s, strlen(s));
+}
+
+void output_char(output_t *out, char c) {
+    reserve(out, 1);
+    out->buffer[out->len++] = c;
+}
+
+// Two digits per step, written backwards from the end of a scratch buffer
+void output_int(output_t *out, long value) {
+    char scratch[OUTPUT_MAX_INT];
+    char *p = scratch + sizeof(scratch);
+    unsigned long v = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    while (v >= 100) {
+        unsigned pair = (v % 100) * 2;
+        v /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (v >= 10) {
+        *--p = digit_pairs[v * 2 + 1];
+        *--p = digit_pairs[v * 2];
+    } else {
+        *--p = '0' + v;
+    }
+    if (value < 0) {
+        *--p = '-';
+    }
+    output_bytes(out, p, scratch + sizeof(scratch) - p);
+}
+
+// Slow path for the odd diagnostic line; events use the calls above
+void output_vprintf(output_t *out, const char *format, va_list args) {
+    char line[512];
+    int n = vsnprintf(line, sizeof(line), format, args);
+    if (n > 0) {
+        output_bytes(out, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+    }
+}
+
+void output_printf(output_t *out, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    output_vprintf(out, format, args);
+    va_end(args);
+}
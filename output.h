@@ -0,0 +1,29 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+#define OUTPUT_BUFFER_SIZE (1 << 18)  // bytes gathered before each write()
+#define OUTPUT_DISCARD -1  // fd that formats everything but writes nothing
+
+// Event log writer. Text is formatted straight into one reusable buffer and
+// handed to write() only when it fills up or on output_flush().
+typedef struct {
+    int fd;  // where the buffer is flushed, or OUTPUT_DISCARD
+    char *buffer;
+    size_t len;
+    int failed;  // a write() failed; later output is dropped
+} output_t;
+
+void output_init(output_t *out, int fd);
+int output_flush(output_t *out);
+void output_destroy(output_t *out);
+void output_bytes(output_t *out, const char *s, size_t n);
+void output_str(output_t *out, const char *s);
+void output_char(output_t *out, char c);
+void output_int(output_t *out, long value);
+void output_vprintf(output_t *out, const char *format, va_list args);
+void output_printf(output_t *out, const char *format, ...);
+
+#endif // OUTPUT_H
@@ -0,0 +1,89 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pool.h"
+
+#define POOL_ALIGN 16
+
+static size_t align_up(size_t n) {
+    return (n + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+}
+
+static void* pool_carve(pool_t *pool, size_t size) {
+    size = align_up(size);
+    pool_block_t *block = pool->blocks;
+    if (!block || block->size - block->used < size) {
+        size_t header = align_up(sizeof(pool_block_t));
+        size_t capacity = size > POOL_BLOCK_SIZE - header ? size : POOL_BLOCK_SIZE - header;
+        block = malloc(header + capacity);
+        if (!block) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        block->next = pool->blocks;
+        block->used = header;
+        block->size = header + capacity;
+        pool->blocks = block;
+    }
+    void *p = (char*)block + block->used;
+    block->used += size;
+    return p;
+}
+
+// smallest class c with (1 << c) ints >= count, never below a pointer's worth
+static int size_class(size_t count) {
+    int c = 1;
+    while (c < POOL_CLASSES - 1 && ((size_t)1 << c) < count) {
+        c++;
+    }
+    return c;
+}
+
+void pool_init(pool_t *pool, size_t object_size) {
+    pool->blocks = NULL;
+    pool->object_size = object_size < sizeof(void*) ? sizeof(void*) : object_size;
+    pool->free_objects = NULL;
+    for (int c = 0; c < POOL_CLASSES; c++) {
+        pool->free_arrays[c] = NULL;
+    }
+}
+
+void* pool_alloc_object(pool_t *pool) {
+    if (pool->free_objects) {
+        void *object = pool->free_objects;
+        pool->free_objects = *(void**)object;
+        return object;
+    }
+    return pool_carve(pool, pool->object_size);
+}
+
+void pool_release_object(pool_t *pool, void *object) {
+    *(void**)object = pool->free_objects;
+    pool->free_objects = object;
+}
+
+int* pool_alloc_ints(pool_t *pool, size_t count) {
+    int c = size_class(count);
+    if (pool->free_arrays[c]) {
+        void *array = pool->free_arrays[c];
+        pool->free_arrays[c] = *(void**)array;
+        return array;
+    }
+    return pool_carve(pool, ((size_t)1 << c) * sizeof(int));
+}
+
+void pool_release_ints(pool_t *pool, int *array, size_t count) {
+    if (!array) return;
+    int c = size_class(count);
+    *(void**)array = pool->free_arrays[c];
+    pool->free_arrays[c] = array;
+}
+
+void pool_destroy(pool_t *pool) {
+    while (pool->blocks) {
+        pool_block_t *next = pool->blocks->next;
+        free(pool->blocks);
+        pool->blocks = next;
+    }
+    pool_init(pool, pool->object_size);
+}
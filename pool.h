@@ -0,0 +1,32 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+#define POOL_BLOCK_SIZE (1 << 20)  // bytes carved per malloc
+#define POOL_CLASSES 33  // power-of-two size classes for int arrays, up to 2 * INT_MAX
+
+typedef struct pool_block {
+    struct pool_block *next;
+    size_t used;
+    size_t size;
+} pool_block_t;
+
+// Bump allocator for fixed-size objects and variable-length int arrays.
+// Released pieces are recycled through free lists; everything goes back to
+// the system at once in pool_destroy().
+typedef struct {
+    pool_block_t *blocks;
+    size_t object_size;  // size of the objects handed out by pool_alloc_object
+    void *free_objects;  // released objects, chained through their first bytes
+    void *free_arrays[POOL_CLASSES];  // released int arrays, by size class
+} pool_t;
+
+void pool_init(pool_t *pool, size_t object_size);
+void* pool_alloc_object(pool_t *pool);
+void pool_release_object(pool_t *pool, void *object);
+int* pool_alloc_ints(pool_t *pool, size_t count);
+void pool_release_ints(pool_t *pool, int *array, size_t count);
+void pool_destroy(pool_t *pool);
+
+#endif // POOL_H
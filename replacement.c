@@ -0,0 +1,412 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory_management.h"
+
+static const char *policy_names[] = { "lru", "fifo", "clock", "lfu", "ws" };
+
+int parse_policy(const char *name, replacement_policy_t *policy) {
+    for (int i = 0; i < (int)(sizeof(policy_names) / sizeof(policy_names[0])); i++) {
+        if (strcmp(name, policy_names[i]) == 0) {
+            *policy = (replacement_policy_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* policy_name(replacement_policy_t policy) {
+    return policy_names[policy];
+}
+
+// LRU and FIFO: in-use frames in a list sorted by (last_used, index).
+// LRU moves a frame to the back whenever it is touched, FIFO never does.
+
+// Time never goes backwards, so a new entry only walks back past frames
+// used at the same time with a higher index
+void lru_insert(sim_t *sim, int frame_number) {
+    int after = sim->lru_tail;
+    while (after != -1 && (sim->frames[after].last_used > sim->frames[frame_number].last_used ||
+            (sim->frames[after].last_used == sim->frames[frame_number].last_used && after > frame_number))) {
+        after = sim->frames[after].lru_prev;
+        INSTRUMENT_COUNT(COUNTER_FRAMES_SCANNED, 1);
+    }
+    int before = after == -1 ? sim->lru_head : sim->frames[after].lru_next;
+    sim->frames[frame_number].lru_prev = after;
+    sim->frames[frame_number].lru_next = before;
+    if (after == -1) {
+        sim->lru_head = frame_number;
+    } else {
+        sim->frames[after].lru_next = frame_number;
+    }
+    if (before == -1) {
+        sim->lru_tail = frame_number;
+    } else {
+        sim->frames[before].lru_prev = frame_number;
+    }
+}
+
+void lru_remove(sim_t *sim, int frame_number) {
+    int prev = sim->frames[frame_number].lru_prev;
+    int next = sim->frames[frame_number].lru_next;
+    if (prev == -1) {
+        sim->lru_head = next;
+    } else {
+        sim->frames[prev].lru_next = next;
+    }
+    if (next == -1) {
+        sim->lru_tail = prev;
+    } else {
+        sim->frames[next].lru_prev = prev;
+    }
+}
+
+void lru_touch(sim_t *sim, int frame_number, int current_time) {
+    lru_remove(sim, frame_number);
+    sim->frames[frame_number].last_used = current_time;
+    lru_insert(sim, frame_number);
+}
+
+// LFU: O(1) per operation. A touched frame moves to the bucket for its
+// count + 1, created right after its current one if it is not there yet.
+
+static int new_bucket(sim_t *sim, int count, int after) {
+    replacement_t *r = &sim->replacement;
+    int b = r->free_buckets[--r->free_bucket_count];
+    lfu_bucket_t *bucket = &r->buckets[b];
+    bucket->count = count;
+    bucket->head = bucket->tail = -1;
+    bucket->prev = after;
+    bucket->next = after == -1 ? r->first_bucket : r->buckets[after].next;
+    if (after == -1) {
+        r->first_bucket = b;
+    } else {
+        r->buckets[after].next = b;
+    }
+    if (bucket->next != -1) {
+        r->buckets[bucket->next].prev = b;
+    }
+    return b;
+}
+
+static void bucket_append(sim_t *sim, int b, int frame_number) {
+    lfu_bucket_t *bucket = &sim->replacement.buckets[b];
+    Frame *frame = &sim->frames[frame_number];
+    frame->bucket = b;
+    frame->lru_prev = bucket->tail;
+    frame->lru_next = -1;
+    if (bucket->tail == -1) {
+        bucket->head = frame_number;
+    } else {
+        sim->frames[bucket->tail].lru_next = frame_number;
+    }
+    bucket->tail = frame_number;
+}
+
+// Take the frame out of its bucket, dropping the bucket once it is empty
+static void bucket_remove(sim_t *sim, int frame_number) {
+    replacement_t *r = &sim->replacement;
+    Frame *frame = &sim->frames[frame_number];
+    int b = frame->bucket;
+    lfu_bucket_t *bucket = &r->buckets[b];
+    if (frame->lru_prev == -1) {
+        bucket->head = frame->lru_next;
+    } else {
+        sim->frames[frame->lru_prev].lru_next = frame->lru_next;
+    }
+    if (frame->lru_next == -1) {
+        bucket->tail = frame->lru_prev;
+    } else {
+        sim->frames[frame->lru_next].lru_prev = frame->lru_prev;
+    }
+    frame->bucket = -1;
+    if (bucket->head != -1) return;
+
+    if (bucket->prev == -1) {
+        r->first_bucket = bucket->next;
+    } else {
+        r->buckets[bucket->prev].next = bucket->next;
+    }
+    if (bucket->next != -1) {
+        r->buckets[bucket->next].prev = bucket->prev;
+    }
+    r->free_buckets[r->free_bucket_count++] = b;
+}
+
+static void lfu_insert(sim_t *sim, int frame_number) {
+    replacement_t *r = &sim->replacement;
+    int b = r->first_bucket;
+    if (b == -1 || r->buckets[b].count != 1) {
+        b = new_bucket(sim, 1, -1);
+    }
+    bucket_append(sim, b, frame_number);
+}
+
+static void lfu_touch(sim_t *sim, int frame_number) {
+    replacement_t *r = &sim->replacement;
+    int b = sim->frames[frame_number].bucket;
+    int count = r->buckets[b].count + 1;
+    int next = r->buckets[b].next;
+    if (next == -1 || r->buckets[next].count != count) {
+        next = new_bucket(sim, count, b);
+    }
+    bucket_remove(sim, frame_number);
+    bucket_append(sim, next, frame_number);
+}
+
+// Whether the frame belongs to requester; a NULL requester owns nothing
+static int owned_by(sim_t *sim, int frame_number, node_t *requester) {
+    return requester != NULL && sim->frames[frame_number].owner == requester->id;
+}
+
+// Whether requester may take the frame. Outside demand paging a process
+// waiting on swap is having its missing pages read in before it runs, so
+// its frames stay put: taking them would only make it fault them back.
+// Demand paging reads after the quantum that used the pages, and a fault
+// must always find a frame, so there nothing is held back.
+static int evictable(sim_t *sim, int frame_number, node_t *requester) {
+    if (owned_by(sim, frame_number, requester)) return 0;
+    return sim->demand || sim->process_table.nodes[sim->frames[frame_number].owner]->state != SWAPPING;
+}
+
+// CLOCK and working set share a hand that sweeps the frame table. Frames
+// that are free or cannot be taken are passed over.
+
+static int clock_victim(sim_t *sim, node_t *requester) {
+    int n = sim->config.num_frames;
+    for (int step = 0; step <= 2 * n; step++) {
+        int f = sim->replacement.hand;
+        sim->replacement.hand = f + 1 == n ? 0 : f + 1;
+        INSTRUMENT_COUNT(COUNTER_FRAMES_SCANNED, 1);
+        if (!frame_in_use(sim, f) || !evictable(sim, f, requester)) continue;
+        if (sim->frames[f].referenced) {
+            sim->frames[f].referenced = 0;  // second chance
+            continue;
+        }
+        return f;
+    }
+    return -1;
+}
+
+// WSClock: a frame referenced since the hand last passed is in the working
+// set as of now; otherwise it is evicted once it has been idle for longer
+// than the window. After a full sweep without one, the stalest frame goes.
+static int working_set_victim(sim_t *sim, node_t *requester, int current_time) {
+    int n = sim->config.num_frames;
+    int oldest = -1;
+    for (int step = 0; step < n; step++) {
+        int f = sim->replacement.hand;
+        sim->replacement.hand = f + 1 == n ? 0 : f + 1;
+        INSTRUMENT_COUNT(COUNTER_FRAMES_SCANNED, 1);
+        if (!frame_in_use(sim, f) || !evictable(sim, f, requester)) continue;
+        if (sim->frames[f].referenced) {
+            sim->frames[f].referenced = 0;
+            sim->frames[f].last_used = current_time;
+        } else if (current_time - sim->frames[f].last_used > sim->config.ws_window) {
+            return f;
+        }
+        if (oldest == -1 || sim->frames[f].last_used < sim->frames[oldest].last_used) {
+            oldest = f;
+        }
+    }
+    if (oldest != -1) {
+        sim->replacement.hand = oldest + 1 == n ? 0 : oldest + 1;
+    }
+    return oldest;
+}
+
+void policy_init(sim_t *sim) {
+    replacement_t *r = &sim->replacement;
+    r->hand = 0;
+    r->buckets = NULL;
+    r->free_buckets = NULL;
+    r->free_bucket_count = 0;
+    r->first_bucket = -1;
+    if (sim->config.policy == POLICY_LFU) {
+        int capacity = sim->config.num_frames + 1;
+        r->buckets = malloc(capacity * sizeof(lfu_bucket_t));
+        r->free_buckets = malloc(capacity * sizeof(int));
+        if (!r->buckets || !r->free_buckets) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = capacity - 1; i >= 0; i--) {
+            r->buckets[i].count = 0;
+            r->buckets[i].head = r->buckets[i].tail = -1;
+            r->buckets[i].prev = r->buckets[i].next = -1;
+            r->free_buckets[r->free_bucket_count++] = i;
+        }
+    }
+}
+
+void policy_destroy(sim_t *sim) {
+    free(sim->replacement.buckets);
+    free(sim->replacement.free_buckets);
+    sim->replacement.buckets = NULL;
+    sim->replacement.free_buckets = NULL;
+}
+
+// A free frame has just been taken at current_time
+void policy_insert(sim_t *sim, int frame_number, int current_time) {
+    Frame *frame = &sim->frames[frame_number];
+    frame->last_used = current_time;
+    frame->referenced = 1;
+    switch (sim->config.policy) {
+    case POLICY_LRU:
+    case POLICY_FIFO:
+        lru_insert(sim, frame_number);
+        break;
+    case POLICY_LFU:
+        lfu_insert(sim, frame_number);
+        break;
+    default:
+        break;
+    }
+}
+
+// The owner of an in-use frame referenced it at current_time
+void policy_touch(sim_t *sim, int frame_number, int current_time) {
+    Frame *frame = &sim->frames[frame_number];
+    switch (sim->config.policy) {
+    case POLICY_LRU:
+        lru_touch(sim, frame_number, current_time);
+        break;
+    case POLICY_FIFO:
+        break;
+    case POLICY_CLOCK:
+        frame->referenced = 1;
+        break;
+    case POLICY_LFU:
+        lfu_touch(sim, frame_number);
+        break;
+    case POLICY_WORKING_SET:
+        frame->referenced = 1;
+        frame->last_used = current_time;
+        break;
+    }
+}
+
+static int compare_frames(const void *a, const void *b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Link frames[0 .. count), out of the LRU list and stamped current_time,
+// which is no earlier than any use in it: they are sorted, then merged by
+// index into the run of frames already used at current_time at its back,
+// one pass instead of a walk back per frame.
+static void lru_merge(sim_t *sim, int *frames, int count, int current_time) {
+    qsort(frames, count, sizeof(int), compare_frames);
+    int run = sim->lru_tail;
+    while (run != -1 && sim->frames[run].last_used == current_time) {
+        run = sim->frames[run].lru_prev;
+        INSTRUMENT_COUNT(COUNTER_FRAMES_SCANNED, 1);
+    }
+    int before = run == -1 ? sim->lru_head : sim->frames[run].lru_next;
+    for (int i = 0; i < count; i++) {
+        int f = frames[i];
+        while (before != -1 && before < f) {
+            before = sim->frames[before].lru_next;
+            INSTRUMENT_COUNT(COUNTER_FRAMES_SCANNED, 1);
+        }
+        int after = before == -1 ? sim->lru_tail : sim->frames[before].lru_prev;
+        sim->frames[f].lru_prev = after;
+        sim->frames[f].lru_next = before;
+        if (after == -1) {
+            sim->lru_head = f;
+        } else {
+            sim->frames[after].lru_next = f;
+        }
+        if (before == -1) {
+            sim->lru_tail = f;
+        } else {
+            sim->frames[before].lru_prev = f;
+        }
+    }
+}
+
+// The owners of frames[0 .. count) each referenced them at current_time,
+// which is no earlier than any use the policy has seen. frames is sorted
+// here under LRU.
+void policy_touch_batch(sim_t *sim, int *frames, int count, int current_time) {
+    if (sim->config.policy != POLICY_LRU) {
+        for (int i = 0; i < count; i++) {
+            policy_touch(sim, frames[i], current_time);
+        }
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        lru_remove(sim, frames[i]);
+        sim->frames[frames[i]].last_used = current_time;
+    }
+    lru_merge(sim, frames, count, current_time);
+}
+
+// frames[0 .. count) were all taken at current_time, as by policy_insert
+// but with LRU and FIFO linked in one pass. frames is sorted here under
+// those two.
+void policy_insert_batch(sim_t *sim, int *frames, int count, int current_time) {
+    if (sim->config.policy != POLICY_LRU && sim->config.policy != POLICY_FIFO) {
+        for (int i = 0; i < count; i++) {
+            policy_insert(sim, frames[i], current_time);
+        }
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        sim->frames[frames[i]].last_used = current_time;
+        sim->frames[frames[i]].referenced = 1;
+    }
+    lru_merge(sim, frames, count, current_time);
+}
+
+// The frame is being freed
+void policy_remove(sim_t *sim, int frame_number) {
+    switch (sim->config.policy) {
+    case POLICY_LRU:
+    case POLICY_FIFO:
+        lru_remove(sim, frame_number);
+        break;
+    case POLICY_LFU:
+        bucket_remove(sim, frame_number);
+        break;
+    default:
+        break;
+    }
+    sim->frames[frame_number].referenced = 0;
+}
+
+static int find_victim(sim_t *sim, node_t *requester, int current_time) {
+    switch (sim->config.policy) {
+    case POLICY_LRU:
+    case POLICY_FIFO:
+        for (int f = sim->lru_head; f != -1; f = sim->frames[f].lru_next) {
+            INSTRUMENT_COUNT(COUNTER_FRAMES_SCANNED, 1);
+            if (evictable(sim, f, requester)) return f;
+        }
+        return -1;
+    case POLICY_CLOCK:
+        return clock_victim(sim, requester);
+    case POLICY_LFU:
+        for (int b = sim->replacement.first_bucket; b != -1; b = sim->replacement.buckets[b].next) {
+            for (int f = sim->replacement.buckets[b].head; f != -1; f = sim->frames[f].lru_next) {
+                INSTRUMENT_COUNT(COUNTER_FRAMES_SCANNED, 1);
+                if (evictable(sim, f, requester)) return f;
+            }
+        }
+        return -1;
+    case POLICY_WORKING_SET:
+        return working_set_victim(sim, requester, current_time);
+    }
+    return -1;
+}
+
+// In-use frame to evict so requester can have it, or -1 if only the
+// requester's own frames and those held for processes waiting on swap are
+// left. A NULL requester owns no frame. The frame is not freed here.
+int policy_victim(sim_t *sim, node_t *requester, int current_time) {
+    INSTRUMENT_DECLARE(start);
+    INSTRUMENT_START(start);
+    int victim = find_victim(sim, requester, current_time);
+    INSTRUMENT_STOP(PHASE_FIND_VICTIM, start);
+    return victim;
+}
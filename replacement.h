@@ -0,0 +1,28 @@
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+// Page replacement policies for the paged and virtual strategies
+typedef enum { POLICY_LRU, POLICY_FIFO, POLICY_CLOCK, POLICY_LFU, POLICY_WORKING_SET } replacement_policy_t;
+
+#define WS_WINDOW 10  // default working-set window, in simulated seconds
+
+// LFU keeps one bucket per distinct use count, lowest count first; the
+// frames in a bucket are linked oldest first through Frame.lru_prev/lru_next.
+typedef struct {
+    int count;
+    int head, tail;
+    int prev, next;
+} lfu_bucket_t;
+
+typedef struct {
+    int hand;  // CLOCK and working set: next frame the hand looks at
+    lfu_bucket_t *buckets;  // LFU: num_frames + 1 of them, enough for any moment
+    int *free_buckets;
+    int free_bucket_count;
+    int first_bucket;  // LFU: bucket with the lowest count, -1 when empty
+} replacement_t;
+
+int parse_policy(const char *name, replacement_policy_t *policy);
+const char* policy_name(replacement_policy_t policy);
+
+#endif // REPLACEMENT_H
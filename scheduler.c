@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory_management.h"
+
+static const char *scheduler_names[] = { "rr", "mlfq", "srtf" };
+
+int parse_scheduler(const char *name, scheduler_t *scheduler) {
+    for (int i = 0; i < (int)(sizeof(scheduler_names) / sizeof(scheduler_names[0])); i++) {
+        if (strcmp(name, scheduler_names[i]) == 0) {
+            *scheduler = (scheduler_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* scheduler_name(scheduler_t scheduler) {
+    return scheduler_names[scheduler];
+}
+
+static void clear_list(list_t *list) {
+    list->head = NULL;
+    list->foot = NULL;
+    list->count = 0;
+}
+
+// Unlink the node right behind prev
+static node_t* remove_after(list_t *list, node_t *prev) {
+    node_t *node = prev->next;
+    prev->next = node->next;
+    if (list->foot == node) {
+        list->foot = prev;
+    }
+    node->next = NULL;
+    list->count--;
+    return node;
+}
+
+// SRTF: binary min-heap on (remain_time, seq), every node knowing its slot
+
+static int runs_before(node_t *a, node_t *b) {
+    return a->remain_time < b->remain_time || (a->remain_time == b->remain_time && a->seq < b->seq);
+}
+
+static void heap_place(runqueue_t *rq, node_t *node, int i) {
+    rq->heap[i] = node;
+    node->heap_index = i;
+}
+
+static void sift_up(runqueue_t *rq, int i) {
+    node_t *node = rq->heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!runs_before(node, rq->heap[parent])) break;
+        heap_place(rq, rq->heap[parent], i);
+        i = parent;
+    }
+    heap_place(rq, node, i);
+}
+
+static void sift_down(runqueue_t *rq, int i) {
+    node_t *node = rq->heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= rq->heap_count) break;
+        if (child + 1 < rq->heap_count && runs_before(rq->heap[child + 1], rq->heap[child])) {
+            child++;
+        }
+        if (!runs_before(rq->heap[child], node)) break;
+        heap_place(rq, rq->heap[child], i);
+        i = child;
+    }
+    heap_place(rq, node, i);
+}
+
+static void heap_push_back(runqueue_t *rq, node_t *node) {
+    if (rq->heap_count == rq->heap_capacity) {
+        int capacity = rq->heap_capacity ? 2 * rq->heap_capacity : 64;
+        node_t **heap = realloc(rq->heap, capacity * sizeof(node_t*));
+        if (!heap) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        rq->heap = heap;
+        rq->heap_capacity = capacity;
+    }
+    heap_place(rq, node, rq->heap_count++);
+}
+
+static void heap_push(runqueue_t *rq, node_t *node) {
+    heap_push_back(rq, node);
+    sift_up(rq, node->heap_index);
+}
+
+static void heap_remove(runqueue_t *rq, node_t *node) {
+    node_t *last = rq->heap[--rq->heap_count];
+    if (last != node) {
+        heap_place(rq, last, node->heap_index);
+        sift_up(rq, last->heap_index);
+        sift_down(rq, last->heap_index);
+    }
+}
+
+// MLFQ: one FIFO per level, level_mask says which are non-empty
+
+static void level_append(runqueue_t *rq, node_t *node) {
+    insert_at_foot(&rq->levels[node->level], node);
+    rq->level_mask |= 1u << node->level;
+}
+
+static node_t* level_pop(runqueue_t *rq, int level) {
+    node_t *node = remove_from_front(&rq->levels[level]);
+    if (rq->levels[level].head == NULL) {
+        rq->level_mask &= ~(1u << level);
+    }
+    return node;
+}
+
+// Every so often all processes go back to the top level, so the long ones
+// demoted to the bottom are not starved by a stream of short arrivals
+static void mlfq_boost(runqueue_t *rq) {
+    for (int level = 1; level < MLFQ_LEVELS; level++) {
+        while (rq->levels[level].head != NULL) {
+            node_t *node = level_pop(rq, level);
+            node->level = 0;
+            node->slice_used = 0;
+            level_append(rq, node);
+        }
+    }
+    rq->boost_in = MLFQ_BOOST;
+}
+
+static void mlfq_tick(runqueue_t *rq) {
+    if (--rq->boost_in == 0) {
+        mlfq_boost(rq);
+    }
+}
+
+void runqueue_init(runqueue_t *rq, scheduler_t scheduler) {
+    rq->scheduler = scheduler;
+    rq->count = 0;
+    for (int level = 0; level < MLFQ_LEVELS; level++) {
+        clear_list(&rq->levels[level]);
+    }
+    rq->level_mask = 0;
+    rq->boost_in = MLFQ_BOOST;
+    rq->heap = NULL;
+    rq->heap_count = 0;
+    rq->heap_capacity = 0;
+}
+
+void runqueue_destroy(runqueue_t *rq) {
+    free(rq->heap);
+    rq->heap = NULL;
+}
+
+// Queue a new arrival, or a process stolen from another CPU
+void runqueue_push(runqueue_t *rq, node_t *node) {
+    switch (rq->scheduler) {
+    case SCHEDULER_RR: insert_at_foot(&rq->levels[0], node); break;
+    case SCHEDULER_MLFQ: level_append(rq, node); break;
+    case SCHEDULER_SRTF: heap_push(rq, node); break;
+    }
+    rq->count++;
+}
+
+// The process that should run next, or NULL when the queue is empty
+node_t* runqueue_next(runqueue_t *rq) {
+    switch (rq->scheduler) {
+    case SCHEDULER_RR: return rq->levels[0].head;
+    case SCHEDULER_MLFQ: return rq->level_mask ? rq->levels[__builtin_ctz(rq->level_mask)].head : NULL;
+    case SCHEDULER_SRTF: return rq->heap_count ? rq->heap[0] : NULL;
+    }
+    return NULL;
+}
+
+// node, the process runqueue_next gave, ran a quantum and has work left
+void runqueue_ran(runqueue_t *rq, node_t *node) {
+    switch (rq->scheduler) {
+    case SCHEDULER_RR:
+        if (rq->levels[0].count > 1) {
+            insert_at_foot(&rq->levels[0], remove_from_front(&rq->levels[0]));
+        }
+        break;
+    case SCHEDULER_MLFQ:
+        // Keeps the CPU until its slice at this level is used up
+        if (++node->slice_used >= 1 << node->level) {
+            level_pop(rq, node->level);
+            if (node->level < MLFQ_LEVELS - 1) {
+                node->level++;
+            }
+            node->slice_used = 0;
+            level_append(rq, node);
+        }
+        mlfq_tick(rq);
+        break;
+    case SCHEDULER_SRTF:
+        sift_up(rq, node->heap_index);  // its remaining time only went down
+        break;
+    }
+}
+
+// Account for quanta a lone node was fast-forwarded over, as if runqueue_ran
+// had been called once for each of them
+void runqueue_advance(runqueue_t *rq, node_t *node, int quanta) {
+    if (rq->scheduler != SCHEDULER_MLFQ) return;
+    while (quanta > 0) {
+        int step = quanta < rq->boost_in ? quanta : rq->boost_in;
+        level_pop(rq, node->level);
+        node->slice_used += step;
+        while (node->level < MLFQ_LEVELS - 1 && node->slice_used >= 1 << node->level) {
+            node->slice_used -= 1 << node->level;
+            node->level++;
+        }
+        node->slice_used %= 1 << node->level;
+        level_append(rq, node);
+        quanta -= step;
+        rq->boost_in -= step;
+        if (rq->boost_in == 0) {
+            mlfq_boost(rq);
+        }
+    }
+}
+
+// node, the process runqueue_next gave, has finished or is blocked on memory
+void runqueue_remove(runqueue_t *rq, node_t *node) {
+    switch (rq->scheduler) {
+    case SCHEDULER_RR: remove_from_front(&rq->levels[0]); break;
+    case SCHEDULER_MLFQ: level_pop(rq, node->level); break;
+    case SCHEDULER_SRTF: heap_remove(rq, node); break;
+    }
+    rq->count--;
+}
+
+// Take a process other than the one due to run next; the queue holds at
+// least two
+node_t* runqueue_steal(runqueue_t *rq) {
+    node_t *node = NULL;
+    int lowest;
+    switch (rq->scheduler) {
+    case SCHEDULER_RR:
+        node = remove_after(&rq->levels[0], rq->levels[0].head);
+        break;
+    case SCHEDULER_MLFQ:
+        // the lowest priority process the CPU would get to last
+        lowest = 31 - __builtin_clz(rq->level_mask);
+        if (lowest == __builtin_ctz(rq->level_mask)) {
+            node = remove_after(&rq->levels[lowest], rq->levels[lowest].head);
+        } else {
+            node = level_pop(rq, lowest);
+        }
+        break;
+    case SCHEDULER_SRTF:
+        node = rq->heap[--rq->heap_count];  // a leaf, so the heap stays valid
+        break;
+    }
+    rq->count--;
+    return node;
+}
+
+// Every queued process, in the order runqueue_restore() needs to rebuild the
+// queue: round robin and each MLFQ level front to back, SRTF in heap order
+void runqueue_walk(runqueue_t *rq, void (*visit)(void *context, node_t *node), void *context) {
+    if (rq->scheduler == SCHEDULER_SRTF) {
+        for (int i = 0; i < rq->heap_count; i++) {
+            visit(context, rq->heap[i]);
+        }
+        return;
+    }
+    for (int level = 0; level < MLFQ_LEVELS; level++) {
+        for (node_t *node = rq->levels[level].head; node != NULL; node = node->next) {
+            visit(context, node);
+        }
+    }
+}
+
+// Put back a process handed out by runqueue_walk(), keeping its place
+void runqueue_restore(runqueue_t *rq, node_t *node) {
+    switch (rq->scheduler) {
+    case SCHEDULER_RR: insert_at_foot(&rq->levels[0], node); break;
+    case SCHEDULER_MLFQ: level_append(rq, node); break;
+    case SCHEDULER_SRTF: heap_push_back(rq, node); break;  // already in heap order
+    }
+    rq->count++;
+}
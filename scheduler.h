@@ -0,0 +1,13 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Which ready process gets the CPU next
+typedef enum { SCHEDULER_RR, SCHEDULER_MLFQ, SCHEDULER_SRTF } scheduler_t;
+
+#define MLFQ_LEVELS 4  // level l lets a process run 2^l quanta before it is demoted
+#define MLFQ_BOOST 64  // quanta run between moving every process back to the top level
+
+int parse_scheduler(const char *name, scheduler_t *scheduler);
+const char* scheduler_name(scheduler_t scheduler);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,936 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+
+typedef struct {
+    FILE *fp;
+    int failed;  // a read or write went wrong, or a value was out of range
+    node_t **order;  // processes in the order they were written or read
+    long order_count;
+    long order_capacity;
+    long size;  // bytes in a file being read, which bounds how much it can describe
+} snapshot_file_t;
+
+// Little-endian values, so snapshots move between machines
+
+static void put_bytes(snapshot_file_t *f, const void *p, size_t n) {
+    if (!f->failed && fwrite(p, 1, n, f->fp) != n) {
+        f->failed = 1;
+    }
+}
+
+static void put_u32(snapshot_file_t *f, uint32_t v) {
+    unsigned char b[4];
+    for (int i = 0; i < 4; i++) {
+        b[i] = (unsigned char)(v >> (8 * i));
+    }
+    put_bytes(f, b, 4);
+}
+
+static void put_u64(snapshot_file_t *f, uint64_t v) {
+    unsigned char b[8];
+    for (int i = 0; i < 8; i++) {
+        b[i] = (unsigned char)(v >> (8 * i));
+    }
+    put_bytes(f, b, 8);
+}
+
+static void put_int(snapshot_file_t *f, int v) {
+    put_u32(f, (uint32_t)v);
+}
+
+static void put_long(snapshot_file_t *f, long v) {
+    put_u64(f, (uint64_t)v);
+}
+
+static void put_double(snapshot_file_t *f, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u64(f, bits);
+}
+
+static void get_bytes(snapshot_file_t *f, void *p, size_t n) {
+    if (f->failed || fread(p, 1, n, f->fp) != n) {
+        f->failed = 1;
+        memset(p, 0, n);
+    }
+}
+
+static uint32_t get_u32(snapshot_file_t *f) {
+    unsigned char b[4];
+    get_bytes(f, b, 4);
+    return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static uint64_t get_u64(snapshot_file_t *f) {
+    uint64_t lo = get_u32(f);
+    uint64_t hi = get_u32(f);
+    return lo | hi << 32;
+}
+
+static int get_int(snapshot_file_t *f) {
+    return (int)get_u32(f);
+}
+
+// An int in [low, high], failing the read otherwise
+static int get_int_in(snapshot_file_t *f, int low, int high) {
+    int v = get_int(f);
+    if (v < low || v > high) {
+        f->failed = 1;
+        return low;
+    }
+    return v;
+}
+
+static long get_long(snapshot_file_t *f) {
+    return (long)get_u64(f);
+}
+
+static double get_double(snapshot_file_t *f) {
+    uint64_t bits = get_u64(f);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static void remember_node(snapshot_file_t *f, node_t *node) {
+    if (f->order_count == f->order_capacity) {
+        long capacity = f->order_capacity ? 2 * f->order_capacity : 256;
+        node_t **order = realloc(f->order, capacity * sizeof(node_t*));
+        if (!order) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        f->order = order;
+        f->order_capacity = capacity;
+    }
+    f->order[f->order_count++] = node;
+}
+
+// Position of node among those written so far, -1 for none
+static long node_position(snapshot_file_t *f, node_t *node) {
+    if (node == NULL) return -1;
+    for (long i = 0; i < f->order_count; i++) {
+        if (f->order[i] == node) return i;
+    }
+    return -1;
+}
+
+static node_t* node_at(snapshot_file_t *f, long position) {
+    if (position < -1 || position >= f->order_count) {
+        f->failed = 1;
+        return NULL;
+    }
+    return position == -1 ? NULL : f->order[position];
+}
+
+// Writing
+
+static void put_node(snapshot_file_t *f, node_t *node) {
+    char pid[MAX_LEN] = { 0 };
+    memcpy(pid, node->pid, strlen(node->pid));
+    put_bytes(f, pid, MAX_LEN);
+    put_int(f, node->arr_time);
+    put_int(f, node->remain_time);
+    put_int(f, node->service_time);
+    put_int(f, node->memory);
+    put_int(f, node->addr);
+    put_int(f, node->num_pages);
+    put_int(f, node->state);
+    put_int(f, node->required_pages);
+    put_int(f, node->id);
+    put_int(f, node->evicted_pages);
+    put_int(f, node->cpu);
+    put_long(f, node->seq);
+    put_int(f, node->level);
+    put_int(f, node->slice_used);
+    put_u64(f, node->access.rng);
+    put_long(f, node->access.pos);
+    put_int(f, node->access.hot_base);
+    put_int(f, node->access.phase_left);
+    put_int(f, node->swap_reads);
+    put_int(f, node->swap_pages);
+    put_int(f, node->swap_ready);
+    put_int(f, node->assigned_frames != NULL);
+    if (node->assigned_frames != NULL) {
+        put_int(f, node->frames_count);
+        for (int i = 0; i < node->frames_count; i++) {
+            put_int(f, node->assigned_frames[i]);
+        }
+        for (int i = 0; i < node->required_pages; i++) {
+            put_int(f, node->page_to_frame_mapping[i]);
+        }
+    }
+    remember_node(f, node);
+}
+
+static void put_list(snapshot_file_t *f, list_t *list) {
+    put_int(f, list->count);
+    for (node_t *node = list->head; node != NULL; node = node->next) {
+        put_node(f, node);
+    }
+}
+
+static void visit_queued(void *context, node_t *node) {
+    put_node(context, node);
+}
+
+static void put_runqueue(snapshot_file_t *f, runqueue_t *rq) {
+    put_int(f, rq->boost_in);
+    put_int(f, rq->count);
+    runqueue_walk(rq, visit_queued, f);
+}
+
+static void visit_hole(void *context, int start, int size) {
+    put_int(context, start);
+    put_int(context, size);
+}
+
+static void count_block(void *context, int start, int order) {
+    (void)start;
+    (void)order;
+    (*(int*)context)++;
+}
+
+static void visit_block(void *context, int start, int order) {
+    put_int(context, start);
+    put_int(context, order);
+}
+
+static void put_memory(snapshot_file_t *f, sim_t *sim) {
+    extent_map_t *map = &sim->memory_map;
+    put_u32(f, map->seed);
+    put_int(f, map->rover);
+    put_int(f, map->holes);
+    extent_map_walk(map, visit_hole, f);
+
+    // Buddy free lists head first, in the order allocation takes them
+    buddy_t *buddy = &sim->buddy;
+    put_int(f, buddy->units > 0);
+    if (buddy->units > 0) {
+        int blocks = 0;
+        buddy_walk(buddy, count_block, &blocks);
+        put_int(f, buddy->used_units);
+        put_long(f, sim->buddy_requested);
+        put_int(f, blocks);
+        buddy_walk(buddy, visit_block, f);
+    }
+
+    put_int(f, sim->used_frames);
+    put_int(f, sim->lru_head);
+    put_int(f, sim->lru_tail);
+    for (int i = 0; i < sim->config.num_frames; i++) {
+        Frame *frame = &sim->frames[i];
+        put_int(f, frame->last_used);
+        put_int(f, frame->referenced);
+        put_int(f, frame->bucket);
+        put_int(f, frame->owner);
+        put_int(f, frame->owner_slot);
+        put_int(f, frame->lru_prev);
+        put_int(f, frame->lru_next);
+        put_int(f, frame->page);
+        put_int(f, frame->prefetched);
+    }
+    for (int w = 0; w < sim->config.frame_words; w++) {
+        put_u64(f, sim->frame_bitmap[w]);
+    }
+
+    replacement_t *r = &sim->replacement;
+    put_int(f, r->hand);
+    put_int(f, r->first_bucket);
+    put_int(f, r->free_bucket_count);
+    if (sim->config.policy == POLICY_LFU) {
+        for (int i = 0; i <= sim->config.num_frames; i++) {
+            lfu_bucket_t *b = &r->buckets[i];
+            put_int(f, b->count);
+            put_int(f, b->head);
+            put_int(f, b->tail);
+            put_int(f, b->prev);
+            put_int(f, b->next);
+        }
+        for (int i = 0; i < r->free_bucket_count; i++) {
+            put_int(f, r->free_buckets[i]);
+        }
+    }
+}
+
+int write_snapshot(sim_t *sim, const char *filename) {
+    snapshot_file_t f = { fopen(filename, "wb"), 0, NULL, 0, 0, 0 };
+    if (f.fp == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", filename);
+        return -1;
+    }
+
+    put_bytes(&f, SNAPSHOT_MAGIC, 4);
+    put_int(&f, SNAPSHOT_VERSION);
+
+    sim_config_t *config = &sim->config;
+    put_int(&f, config->memory_kb);
+    put_int(&f, config->page_size);
+    put_int(&f, config->min_pages);
+    put_int(&f, config->policy);
+    put_int(&f, config->ws_window);
+    put_int(&f, config->cpus);
+    put_int(&f, config->scheduler);
+    put_int(&f, config->access.kind);
+    put_int(&f, config->access.rate);
+    put_int(&f, config->access.hot_pages);
+    put_int(&f, config->access.hot_percent);
+    put_int(&f, config->access.phase);
+    put_u64(&f, config->access.seed);
+    put_int(&f, config->compact_threshold);
+    put_int(&f, config->compact_cost);
+    put_int(&f, config->swap.enabled);
+    put_int(&f, config->swap.read_latency);
+    put_int(&f, config->swap.read_rate);
+    put_int(&f, config->swap.write_latency);
+    put_int(&f, config->swap.write_rate);
+    put_int(&f, config->swap.prefetch);
+    put_int(&f, sim->quantum);
+    put_int(&f, (int)strlen(sim->strategy));
+    put_bytes(&f, sim->strategy, strlen(sim->strategy));
+    put_int(&f, sim->clock);
+    put_int(&f, sim->clock_start);
+
+    summary_t *s = &sim->summary;
+    put_long(&f, s->processes);
+    put_double(&f, s->total_turnaround);
+    put_int(&f, s->max_turnaround);
+    put_double(&f, s->total_overhead);
+    put_double(&f, s->max_overhead);
+    put_int(&f, s->makespan);
+    put_long(&f, s->page_faults);
+    put_long(&f, s->refaults);
+    put_long(&f, s->evictions);
+    put_long(&f, s->stuck);
+    put_int(&f, s->max_internal_frag);
+    put_long(&f, s->accesses);
+    put_long(&f, s->compactions);
+    put_long(&f, s->compacted_kb);
+    put_long(&f, s->compaction_time);
+    put_long(&f, s->swap_ins);
+    put_long(&f, s->swap_outs);
+    put_long(&f, s->swap_wait);
+    put_long(&f, s->prefetched);
+    put_long(&f, s->prefetch_hits);
+    put_long(&f, sim->quanta);
+    put_long(&f, sim->allocations);
+    put_long(&f, sim->arrivals);
+    put_long(&f, sim->trace_pos);
+
+    process_table_t *table = &sim->process_table;
+    put_int(&f, table->count);
+    put_int(&f, table->free_count);
+    for (int i = 0; i < table->free_count; i++) {
+        put_int(&f, table->free_ids[i]);
+    }
+
+    put_memory(&f, sim);
+
+    put_list(&f, &sim->input_queue);
+    put_list(&f, &sim->blocked);
+    put_int(&f, sim->blocked_need);
+    put_list(&f, &sim->swapping);
+    put_int(&f, sim->swap_busy_until);
+    put_int(&f, sim->swap_writes);
+    if (sim->cpus) {
+        for (int c = 0; c < config->cpus; c++) {
+            put_long(&f, sim->cpus[c].busy);
+            put_long(&f, sim->cpus[c].migrations);
+            put_runqueue(&f, &sim->cpus[c].queue);
+        }
+        for (int c = 0; c < config->cpus; c++) {
+            put_long(&f, node_position(&f, sim->cpus[c].prev));
+        }
+    } else {
+        put_runqueue(&f, &sim->ready_queue);
+        put_long(&f, node_position(&f, sim->prev));
+    }
+
+    free(f.order);
+    if (fclose(f.fp) != 0 || f.failed) {
+        fprintf(stderr, "Failed to write file %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Reading
+
+// Whether the run pages virtual memory on demand; set up before the body is read
+static int demand_paged(sim_t *sim) {
+    return sim->config.access.kind != ACCESS_NONE && strcmp(sim->strategy, "virtual") == 0;
+}
+
+static node_t* get_node(snapshot_file_t *f, sim_t *sim) {
+    char pid[MAX_LEN + 1] = { 0 };
+    get_bytes(f, pid, MAX_LEN);
+    int arr_time = get_int(f);
+    int remain_time = get_int(f);
+    int service_time = get_int(f);
+    int memory = get_int_in(f, 0, INT32_MAX);
+    if (f->failed) return NULL;
+
+    node_t *node = create_node(sim, pid, arr_time, remain_time, memory);
+    node->service_time = service_time;
+    node->addr = get_int_in(f, -1, sim->config.memory_kb - 1);
+    node->num_pages = get_int(f);
+    node->state = get_int_in(f, READY, SWAPPING);
+    if (get_int(f) != node->required_pages) {
+        f->failed = 1;
+    }
+    node->id = get_int_in(f, -1, sim->process_table.count - 1);
+    node->evicted_pages = get_int(f);
+    node->cpu = get_int_in(f, -1, sim->cpus ? sim->config.cpus - 1 : -1);
+    node->seq = get_long(f);
+    node->level = get_int_in(f, 0, MLFQ_LEVELS - 1);
+    node->slice_used = get_int(f);
+    node->access.rng = get_u64(f);
+    node->access.pos = get_long(f);
+    node->access.hot_base = get_int_in(f, 0, node->required_pages > 0 ? node->required_pages - 1 : 0);
+    node->access.phase_left = get_int_in(f, 0, sim->config.access.phase);
+    node->swap_reads = get_int_in(f, 0, INT32_MAX);
+    node->swap_pages = get_int_in(f, 0, INT32_MAX);
+    node->swap_ready = get_int(f);
+    if (get_int(f)) {
+        // Page table, under the id the process held before
+        process_table_t *table = &sim->process_table;
+        if (node->id < 0 || table->nodes[node->id] != NULL) {
+            f->failed = 1;
+            return node;
+        }
+        table->nodes[node->id] = node;
+        int pages = node->required_pages;
+        // Only demand paging gives a process more pages than there are
+        // frames, and every page takes 4 bytes of the file
+        if ((!demand_paged(sim) && pages > sim->config.num_frames) || pages > (f->size - ftell(f->fp)) / 4) {
+            f->failed = 1;
+            return node;
+        }
+        int *frames = pool_alloc_ints(&sim->node_pool, 2 * (size_t)pages);
+        node->assigned_frames = frames;
+        node->page_to_frame_mapping = frames + pages;
+        node->frames_count = get_int_in(f, 0, pages);
+        for (int i = 0; i < node->frames_count; i++) {
+            node->assigned_frames[i] = get_int_in(f, 0, sim->config.num_frames - 1);
+        }
+        for (int i = 0; i < pages; i++) {
+            node->page_to_frame_mapping[i] = get_int_in(f, PAGE_EVICTED, sim->config.num_frames - 1);
+        }
+    } else if (node->id != -1) {
+        f->failed = 1;
+    }
+    remember_node(f, node);
+    return node;
+}
+
+static void get_list(snapshot_file_t *f, sim_t *sim, list_t *list) {
+    int count = get_int_in(f, 0, INT32_MAX);
+    for (int i = 0; i < count && !f->failed; i++) {
+        node_t *node = get_node(f, sim);
+        if (node != NULL) {
+            insert_at_foot(list, node);
+        }
+    }
+}
+
+static void get_runqueue(snapshot_file_t *f, sim_t *sim, runqueue_t *rq) {
+    rq->boost_in = get_int_in(f, 1, MLFQ_BOOST);
+    int count = get_int_in(f, 0, INT32_MAX);
+    for (int i = 0; i < count && !f->failed; i++) {
+        node_t *node = get_node(f, sim);
+        if (node != NULL) {
+            runqueue_restore(rq, node);
+        }
+    }
+}
+
+static void get_memory(snapshot_file_t *f, sim_t *sim) {
+    int frames = sim->config.num_frames;
+    extent_map_t *map = &sim->memory_map;
+    unsigned seed = get_u32(f);
+    int rover = get_int_in(f, 0, sim->config.memory_kb);
+    int holes = get_int_in(f, 0, sim->config.memory_kb);
+    extent_map_destroy(map);
+    extent_map_init(map, 0);
+    map->total = sim->config.memory_kb;
+    int end = 0;  // holes come lowest address first and never touch
+    for (int i = 0; i < holes && !f->failed; i++) {
+        int start = get_int_in(f, end, sim->config.memory_kb - 1);
+        int size = get_int_in(f, 1, sim->config.memory_kb - start);
+        if (f->failed || (i > 0 && start == end)) {
+            f->failed = 1;
+            break;
+        }
+        extent_free(map, start, size);
+        end = start + size;
+    }
+    map->seed = seed;
+    map->rover = rover;
+
+    if (get_int(f) && !f->failed) {
+        buddy_t *buddy = &sim->buddy;
+        buddy_init(buddy, frames);
+        // Claim every block, then free the saved ones tail first so each
+        // list ends up in its saved order. Free blocks never have a free
+        // buddy, so nothing merges on the way.
+        while (buddy->order_mask) {
+            buddy_alloc(buddy, __builtin_ctz(buddy->order_mask));
+        }
+        int used_units = get_int_in(f, 0, frames);
+        sim->buddy_requested = get_long(f);
+        int blocks = get_int_in(f, 0, frames);
+        int *saved = malloc((2 * (size_t)blocks + 1) * sizeof(int));
+        if (saved == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < blocks && !f->failed; i++) {
+            saved[2 * i] = get_int_in(f, 0, frames - 1);
+            saved[2 * i + 1] = get_int_in(f, 0, buddy->orders - 1);
+            if ((saved[2 * i] & ((1 << saved[2 * i + 1]) - 1)) != 0 ||
+                (long)saved[2 * i] + (1L << saved[2 * i + 1]) > frames) {
+                f->failed = 1;
+            }
+        }
+        for (int i = blocks - 1; i >= 0 && !f->failed; i--) {
+            buddy_free(buddy, saved[2 * i], saved[2 * i + 1]);
+        }
+        free(saved);
+        buddy->used_units = used_units;
+    }
+
+    sim->used_frames = get_int_in(f, 0, frames);
+    sim->lru_head = get_int_in(f, -1, frames - 1);
+    sim->lru_tail = get_int_in(f, -1, frames - 1);
+    for (int i = 0; i < frames && !f->failed; i++) {
+        Frame *frame = &sim->frames[i];
+        frame->last_used = get_int(f);
+        frame->referenced = get_int(f);
+        frame->bucket = get_int_in(f, -1, frames);
+        frame->owner = get_int_in(f, -1, sim->process_table.count - 1);
+        frame->owner_slot = get_int(f);
+        frame->lru_prev = get_int_in(f, -1, frames - 1);
+        frame->lru_next = get_int_in(f, -1, frames - 1);
+        frame->page = get_int_in(f, -1, INT32_MAX);
+        frame->prefetched = get_int_in(f, 0, 1);
+    }
+    for (int w = 0; w < sim->config.frame_words; w++) {
+        sim->frame_bitmap[w] = get_u64(f);
+    }
+
+    replacement_t *r = &sim->replacement;
+    r->hand = get_int_in(f, 0, frames - 1);
+    r->first_bucket = get_int_in(f, -1, frames);
+    r->free_bucket_count = get_int_in(f, 0, sim->config.policy == POLICY_LFU ? frames + 1 : 0);
+    if (sim->config.policy == POLICY_LFU) {
+        for (int i = 0; i <= frames && !f->failed; i++) {
+            lfu_bucket_t *b = &r->buckets[i];
+            b->count = get_int(f);
+            b->head = get_int_in(f, -1, frames - 1);
+            b->tail = get_int_in(f, -1, frames - 1);
+            b->prev = get_int_in(f, -1, frames);
+            b->next = get_int_in(f, -1, frames);
+        }
+        for (int i = 0; i < r->free_bucket_count; i++) {
+            r->free_buckets[i] = get_int_in(f, 0, frames);
+        }
+    }
+}
+
+static void get_process_table(snapshot_file_t *f, sim_t *sim) {
+    process_table_t *table = &sim->process_table;
+    // Every id is either free or held by a process, so each takes 4 bytes at least
+    int count = get_int_in(f, 0, f->size / 4 < INT32_MAX / 2 ? (int)(f->size / 4) : INT32_MAX / 2);
+    int free_count = get_int_in(f, 0, count);
+    if (f->failed) return;
+    int capacity = 64;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    table->nodes = calloc(capacity, sizeof(node_t*));
+    table->free_ids = malloc(capacity * sizeof(int));
+    if (!table->nodes || !table->free_ids) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    table->capacity = capacity;
+    table->count = count;
+    table->free_count = free_count;
+    for (int i = 0; i < free_count; i++) {
+        table->free_ids[i] = get_int_in(f, 0, count - 1);
+    }
+}
+
+// Consistency. Every value read is in range, but the state must also hang
+// together as the simulator keeps it, or resuming could crash or loop.
+
+// Page tables and frames must point at each other, and every process id
+// must be either free or held
+static int frames_consistent(sim_t *sim) {
+    process_table_t *table = &sim->process_table;
+    int frames = sim->config.num_frames;
+    int used = 0;
+    for (int w = 0; w < sim->config.frame_words; w++) {
+        uint64_t word = sim->frame_bitmap[w];
+        if (w == sim->config.frame_words - 1 && frames % 64 != 0 && (word >> (frames % 64)) != 0) {
+            return 0;
+        }
+        used += __builtin_popcountll(word);
+    }
+    if (used != sim->used_frames) return 0;
+    for (int i = 0; i < frames; i++) {
+        Frame *frame = &sim->frames[i];
+        if (frame->owner < 0) {
+            // Every frame in use has an owner, and a free one holds no page
+            if (frame_in_use(sim, i) || frame->page != -1) return 0;
+            continue;
+        }
+        node_t *owner = table->nodes[frame->owner];
+        if (owner == NULL || !frame_in_use(sim, i) || frame->owner_slot < 0 ||
+            frame->owner_slot >= owner->frames_count || owner->assigned_frames[frame->owner_slot] != i) {
+            return 0;
+        }
+        if (frame->page != -1 && (frame->page >= owner->required_pages || owner->page_to_frame_mapping[frame->page] != i)) {
+            return 0;
+        }
+    }
+    int held = 0;
+    for (int id = 0; id < table->count; id++) {
+        node_t *node = table->nodes[id];
+        if (node == NULL) continue;
+        held++;
+        for (int i = 0; i < node->frames_count; i++) {
+            Frame *frame = &sim->frames[node->assigned_frames[i]];
+            if (frame->owner != id || frame->owner_slot != i) return 0;
+        }
+        for (int page = 0; page < node->required_pages; page++) {
+            int f = node->page_to_frame_mapping[page];
+            if (f >= 0 && (sim->frames[f].owner != id || (sim->frames[f].page != -1 && sim->frames[f].page != page))) {
+                return 0;
+            }
+        }
+    }
+    // Free ids hold nobody and appear once, so they make up the rest
+    char *seen = calloc(table->count + 1, 1);
+    if (!seen) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    int ok = held + table->free_count == table->count;
+    for (int i = 0; i < table->free_count && ok; i++) {
+        int id = table->free_ids[i];
+        ok = table->nodes[id] == NULL && !seen[id];
+        seen[id] = 1;
+    }
+    free(seen);
+    return ok;
+}
+
+// The LRU and FIFO list runs from lru_head to lru_tail through exactly the
+// in-use frames, sorted by (last_used, index)
+static int lru_consistent(sim_t *sim) {
+    int prev = -1;
+    int length = 0;
+    for (int i = sim->lru_head; i != -1; i = sim->frames[i].lru_next) {
+        Frame *frame = &sim->frames[i];
+        if (++length > sim->used_frames || !frame_in_use(sim, i) || frame->lru_prev != prev) return 0;
+        if (prev != -1 && (sim->frames[prev].last_used > frame->last_used ||
+                (sim->frames[prev].last_used == frame->last_used && prev > i))) {
+            return 0;
+        }
+        prev = i;
+    }
+    return prev == sim->lru_tail && length == sim->used_frames;
+}
+
+// The LFU buckets run from first_bucket in increasing count, none of them
+// empty, and between them hold exactly the in-use frames; the rest are free
+static int lfu_consistent(sim_t *sim) {
+    replacement_t *r = &sim->replacement;
+    int frames = sim->config.num_frames;
+    char *seen = calloc(frames + 1, 1);
+    if (!seen) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    int ok = 1;
+    int buckets = 0, held = 0;
+    int prev_bucket = -1;
+    for (int b = r->first_bucket; b != -1 && ok; b = r->buckets[b].next) {
+        lfu_bucket_t *bucket = &r->buckets[b];
+        ok = !seen[b] && bucket->prev == prev_bucket && bucket->head != -1 &&
+             (prev_bucket == -1 || r->buckets[prev_bucket].count < bucket->count);
+        seen[b] = 1;
+        buckets++;
+        int prev = -1;
+        for (int i = bucket->head; i != -1 && ok; i = sim->frames[i].lru_next) {
+            ok = ++held <= sim->used_frames && frame_in_use(sim, i) &&
+                 sim->frames[i].bucket == b && sim->frames[i].lru_prev == prev;
+            prev = i;
+        }
+        ok = ok && prev == bucket->tail;
+        prev_bucket = b;
+    }
+    for (int i = 0; i < r->free_bucket_count && ok; i++) {
+        ok = !seen[r->free_buckets[i]];
+        seen[r->free_buckets[i]] = 1;
+    }
+    free(seen);
+    return ok && held == sim->used_frames && buckets + r->free_bucket_count == frames + 1;
+}
+
+typedef struct {
+    long start, size;
+} span_t;
+
+typedef struct {
+    span_t *spans;
+    long count;
+    int page_size;
+} span_list_t;
+
+static void add_hole(void *context, int start, int size) {
+    span_list_t *list = context;
+    list->spans[list->count++] = (span_t){ start, size };
+}
+
+static void add_block(void *context, int start, int order) {
+    span_list_t *list = context;
+    list->spans[list->count++] = (span_t){ (long)start * list->page_size, (long)list->page_size << order };
+}
+
+static int by_start(const void *a, const void *b) {
+    long x = ((const span_t*)a)->start, y = ((const span_t*)b)->start;
+    return (x > y) - (x < y);
+}
+
+// Free holes or buddy blocks and the memory of every resident process must
+// lie inside memory without overlapping
+static int contiguous_consistent(snapshot_file_t *f, sim_t *sim) {
+    int buddy = strcmp(sim->strategy, "buddy") == 0;
+    long free_spans = buddy ? (sim->buddy.units > 0 ? sim->buddy.units : 0) : sim->memory_map.holes;
+    span_list_t list = { malloc((free_spans + f->order_count + 1) * sizeof(span_t)), 0, sim->config.page_size };
+    if (!list.spans) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    long used_units = 0, requested = 0;
+    if (buddy) {
+        if (sim->buddy.units > 0) {
+            buddy_walk(&sim->buddy, add_block, &list);
+        }
+    } else {
+        extent_map_walk(&sim->memory_map, add_hole, &list);
+    }
+    int ok = list.count <= free_spans;
+    for (long i = 0; i < f->order_count && ok; i++) {
+        node_t *node = f->order[i];
+        if (node->addr < 0) continue;
+        long size = node->memory;
+        if (buddy) {
+            int order = buddy_order(node->required_pages);
+            size = (long)sim->config.page_size << order;
+            ok = sim->buddy.units > 0 && node->addr % size == 0;
+            used_units += 1L << order;
+            requested += node->memory;
+        }
+        list.spans[list.count++] = (span_t){ node->addr, size };
+    }
+    qsort(list.spans, list.count, sizeof(span_t), by_start);
+    long end = 0;
+    for (long i = 0; i < list.count && ok; i++) {
+        ok = list.spans[i].start >= end && list.spans[i].size > 0;
+        end = list.spans[i].start + list.spans[i].size;
+    }
+    ok = ok && end <= sim->config.memory_kb;
+    if (buddy && sim->buddy.units > 0) {
+        ok = ok && used_units == sim->buddy.used_units && requested == sim->buddy_requested;
+    }
+    free(list.spans);
+    return ok;
+}
+
+// Processes waiting for swap come back in the order the device serves them
+static int swapping_consistent(sim_t *sim) {
+    for (node_t *node = sim->swapping.head; node != NULL && node->next != NULL; node = node->next) {
+        if (node->swap_ready > node->next->swap_ready) return 0;
+    }
+    return 1;
+}
+
+static int state_consistent(snapshot_file_t *f, sim_t *sim) {
+    if (!frames_consistent(sim) || !swapping_consistent(sim)) return 0;
+    if (is_contiguous_strategy(sim->strategy) && !contiguous_consistent(f, sim)) return 0;
+    switch (sim->config.policy) {
+    case POLICY_LRU:
+    case POLICY_FIFO:
+        return lru_consistent(sim);
+    case POLICY_LFU:
+        return lfu_consistent(sim);
+    default:
+        return 1;
+    }
+}
+
+static int read_body(snapshot_file_t *f, sim_t *sim) {
+    summary_t *s = &sim->summary;
+    s->processes = get_long(f);
+    s->total_turnaround = get_double(f);
+    s->max_turnaround = get_int(f);
+    s->total_overhead = get_double(f);
+    s->max_overhead = get_double(f);
+    s->makespan = get_int(f);
+    s->page_faults = get_long(f);
+    s->refaults = get_long(f);
+    s->evictions = get_long(f);
+    s->stuck = get_long(f);
+    s->max_internal_frag = get_int(f);
+    s->accesses = get_long(f);
+    s->compactions = get_long(f);
+    s->compacted_kb = get_long(f);
+    s->compaction_time = get_long(f);
+    s->swap_ins = get_long(f);
+    s->swap_outs = get_long(f);
+    s->swap_wait = get_long(f);
+    s->prefetched = get_long(f);
+    s->prefetch_hits = get_long(f);
+    sim->quanta = get_long(f);
+    sim->allocations = get_long(f);
+    long arrivals = get_long(f);
+    sim->trace_pos = get_long(f);
+
+    get_process_table(f, sim);
+    get_memory(f, sim);
+
+    get_list(f, sim, &sim->input_queue);
+    get_list(f, sim, &sim->blocked);
+    sim->blocked_need = get_int(f);
+    get_list(f, sim, &sim->swapping);
+    sim->swap_busy_until = get_int(f);
+    sim->swap_writes = get_int_in(f, 0, INT32_MAX);
+    if (sim->cpus) {
+        for (int c = 0; c < sim->config.cpus && !f->failed; c++) {
+            sim->cpus[c].busy = get_long(f);
+            sim->cpus[c].migrations = get_long(f);
+            get_runqueue(f, sim, &sim->cpus[c].queue);
+        }
+        for (int c = 0; c < sim->config.cpus && !f->failed; c++) {
+            sim->cpus[c].prev = node_at(f, get_long(f));
+        }
+    } else {
+        get_runqueue(f, sim, &sim->ready_queue);
+        sim->prev = node_at(f, get_long(f));
+    }
+    // create_node() counted the restored processes as new arrivals
+    sim->arrivals = arrivals;
+
+    char extra;
+    if (!f->failed && fread(&extra, 1, 1, f->fp) != 0) {
+        f->failed = 1;
+    }
+    return f->failed ? -1 : 0;
+}
+
+int read_snapshot(sim_t *sim, const char *filename, int out_fd) {
+    snapshot_file_t f = { fopen(filename, "rb"), 0, NULL, 0, 0, 0 };
+    if (f.fp == NULL) {
+        fprintf(stderr, "Failed to open file %s\n", filename);
+        return -1;
+    }
+    if (fseek(f.fp, 0, SEEK_END) == 0) {
+        f.size = ftell(f.fp);
+    }
+    rewind(f.fp);
+
+    char magic[4];
+    get_bytes(&f, magic, 4);
+    if (f.failed || memcmp(magic, SNAPSHOT_MAGIC, 4) != 0 || get_int(&f) != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Not a snapshot file %s\n", filename);
+        fclose(f.fp);
+        return -1;
+    }
+
+    sim_config_t config;
+    int memory_kb = get_int(&f);
+    int page_size = get_int(&f);
+    int min_pages = get_int(&f);
+    // Every frame takes nine ints further on, so the file bounds memory
+    if (init_config(&config, memory_kb, page_size, min_pages) != 0 || config.num_frames > f.size / 36) {
+        f.failed = 1;
+    }
+    config.policy = get_int_in(&f, POLICY_LRU, POLICY_WORKING_SET);
+    config.ws_window = get_int(&f);
+    config.cpus = get_int_in(&f, 1, MAX_CPUS);
+    config.scheduler = get_int_in(&f, SCHEDULER_RR, SCHEDULER_SRTF);
+    config.access.kind = get_int_in(&f, ACCESS_NONE, ACCESS_TRACE);
+    config.access.rate = get_int_in(&f, 1, INT32_MAX);
+    config.access.hot_pages = get_int_in(&f, 1, INT32_MAX);
+    config.access.hot_percent = get_int_in(&f, 0, 100);
+    config.access.phase = get_int_in(&f, 1, INT32_MAX);
+    config.access.seed = get_u64(&f);
+    config.compact_threshold = get_int_in(&f, -1, 100);
+    config.compact_cost = get_int_in(&f, 0, INT32_MAX);
+    config.swap.enabled = get_int_in(&f, 0, 1);
+    config.swap.read_latency = get_int_in(&f, 0, INT32_MAX / 2);
+    config.swap.read_rate = get_int_in(&f, 1, INT32_MAX);
+    config.swap.write_latency = get_int_in(&f, 0, INT32_MAX / 2);
+    config.swap.write_rate = get_int_in(&f, 1, INT32_MAX);
+    config.swap.prefetch = get_int_in(&f, 0, INT32_MAX);
+    int quantum = get_int_in(&f, 1, INT32_MAX);
+    int strategy_len = get_int_in(&f, 1, MAX_STRATEGY_LEN);
+    char strategy[MAX_STRATEGY_LEN + 1] = { 0 };
+    get_bytes(&f, strategy, strategy_len);
+    int clock = get_int(&f);
+    int clock_start = get_int(&f);
+    if (f.failed || !is_valid_strategy(strategy)) {
+        fprintf(stderr, "Invalid snapshot file %s\n", filename);
+        fclose(f.fp);
+        return -1;
+    }
+
+    sim_init(sim, &config, out_fd);
+    sim->quantum = quantum;
+    memcpy(sim->strategy, strategy, sizeof(strategy));
+    sim->clock = clock;
+    sim->clock_start = clock_start;
+    sim->resumed = 1;
+    int status = read_body(&f, sim);
+    if (status != 0) {
+        fprintf(stderr, "Invalid snapshot file %s\n", filename);
+    } else if (!state_consistent(&f, sim)) {
+        fprintf(stderr, "Snapshot is corrupt\n");
+        status = -1;
+    }
+    free(f.order);
+    fclose(f.fp);
+    if (status != 0) {
+        sim_destroy(sim);
+        return -1;
+    }
+    return 0;
+}
+
+int resume_trace(sim_t *sim) {
+    if (sim->trace != NULL && sim->trace_pos > sim->trace->count) {
+        fprintf(stderr, "Snapshot does not match the trace\n");
+        return -1;
+    }
+    if (sim->input_feed != NULL && trace_feed_skip(sim->input_feed, sim->trace_pos) != 0) {
+        fprintf(stderr, "Snapshot does not match the trace\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Called by the schedulers at the top of a pass once the clock reaches
+// snapshot_time; the run then carries on as if nothing happened
+void take_snapshot(sim_t *sim, int time) {
+    sim->clock = time;
+    if (write_snapshot(sim, sim->snapshot_path) != 0) {
+        sim->snapshot_failed = 1;
+    }
+    sim->snapshot_path = NULL;
+}
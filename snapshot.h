@@ -0,0 +1,22 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "memory_management.h"
+
+#define SNAPSHOT_MAGIC "RRSS"  // first bytes of a snapshot file
+#define SNAPSHOT_VERSION 5
+
+// A snapshot holds everything a run needs to carry on from a scheduling
+// point: the configuration, quantum and strategy, the clock, the metrics so
+// far, the free holes and buddy blocks, every frame and the replacement
+// state, the process table, and each process waiting to arrive, blocked on
+// memory or for swap or queued on a CPU, with its page table. All values
+// are little-endian.
+
+int write_snapshot(sim_t *sim, const char *filename);
+// Initialises sim from the snapshot; on failure sim is left uninitialised
+int read_snapshot(sim_t *sim, const char *filename, int out_fd);
+// Moves the trace attached to a resumed sim past the records already read
+int resume_trace(sim_t *sim);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "swap.h"
+
+void swap_config_init(swap_config_t *config) {
+    config->enabled = 0;
+    config->read_latency = config->write_latency = SWAP_LATENCY;
+    config->read_rate = config->write_rate = SWAP_RATE;
+    config->prefetch = 0;
+}
+
+// "<read latency>[:<read KB per time unit>[:<write latency>[:<write KB per
+// time unit>]]]"; writes default to the read figures. Returns -1 when malformed.
+int parse_swap_config(const char *text, swap_config_t *config) {
+    long values[4] = { SWAP_LATENCY, SWAP_RATE, -1, -1 };
+    const char *p = text;
+    for (int i = 0; i < 4; i++) {
+        char *end;
+        values[i] = strtol(p, &end, 10);
+        if (end == p) return -1;
+        p = end;
+        if (*p != ':' || i == 3) break;
+        p++;
+    }
+    if (values[2] == -1) values[2] = values[0];
+    if (values[3] == -1) values[3] = values[1];
+    if (*p != '\0' || values[0] < 0 || values[0] > INT_MAX / 2 || values[2] < 0 || values[2] > INT_MAX / 2 ||
+            values[1] < 1 || values[1] > INT_MAX || values[3] < 1 || values[3] > INT_MAX) {
+        return -1;
+    }
+    config->enabled = 1;
+    config->read_latency = (int)values[0];
+    config->read_rate = (int)values[1];
+    config->write_latency = (int)values[2];
+    config->write_rate = (int)values[3];
+    return 0;
+}
+
+// Queues requests moving kb in all behind whatever the device is still
+// doing at time. Returns when they complete; *busy_until moves there too.
+int swap_transfer(int *busy_until, const swap_config_t *config, int time, int requests, long kb, int write) {
+    int latency = write ? config->write_latency : config->read_latency;
+    int rate = write ? config->write_rate : config->read_rate;
+    long start = *busy_until > time ? *busy_until : time;
+    long done = start + (long)requests * latency + (kb + rate - 1) / rate;
+    *busy_until = done > INT_MAX ? INT_MAX : (int)done;
+    return *busy_until;
+}
@@ -0,0 +1,23 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#define SWAP_LATENCY 1  // default time a request waits before data moves
+#define SWAP_RATE 1024  // default KB moved per time unit
+
+// Simulated swap device. Requests are served one at a time in the order
+// they were issued; each pays the device's latency and then moves its KB at
+// the device's rate.
+typedef struct {
+    int enabled;  // evictions are written to swap and refaults read back
+    int read_latency;  // time before a read starts moving data
+    int read_rate;  // KB a read moves per time unit
+    int write_latency;
+    int write_rate;
+    int prefetch;  // demand paging: swapped-out pages read along with a swap-in
+} swap_config_t;
+
+void swap_config_init(swap_config_t *config);
+int parse_swap_config(const char *text, swap_config_t *config);
+int swap_transfer(int *busy_until, const swap_config_t *config, int time, int requests, long kb, int write);
+
+#endif // SWAP_H
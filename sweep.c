@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "memory_management.h"
+#include "sweep.h"
+
+typedef struct {
+    int quantum;
+    char *strategy;
+    replacement_policy_t policy;
+    scheduler_t scheduler;
+} sweep_job_t;
+
+// Shared by every worker; the trace is only ever read
+typedef struct {
+    const trace_t *trace;
+    const sim_config_t *config;
+    const char *out_dir;
+    event_format_t format;
+    int name_policy;  // several policies are swept, so file names carry the policy
+    int name_scheduler;  // likewise for schedulers
+    sweep_job_t *jobs;
+    int num_jobs;
+    atomic_int next_job;
+    atomic_int failed;
+} sweep_t;
+
+static int run_job(sweep_t *sweep, sweep_job_t *job) {
+    char path[4096];
+    int len = snprintf(path, sizeof(path), "%s/%s", sweep->out_dir, job->strategy);
+    if (sweep->name_policy && len < (int)sizeof(path)) {
+        len += snprintf(path + len, sizeof(path) - len, "-%s", policy_name(job->policy));
+    }
+    if (sweep->name_scheduler && len < (int)sizeof(path)) {
+        len += snprintf(path + len, sizeof(path) - len, "-%s", scheduler_name(job->scheduler));
+    }
+    if (len < (int)sizeof(path)) {
+        snprintf(path + len, sizeof(path) - len, "-q%d.%s", job->quantum,
+            event_format_extension(sweep->format));
+    }
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) {
+        fprintf(stderr, "Failed to open file %s\n", path);
+        return -1;
+    }
+
+    sim_t *sim = malloc(sizeof(sim_t));
+    if (!sim) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    sim_config_t config = *sweep->config;
+    config.policy = job->policy;
+    config.scheduler = job->scheduler;
+    sim_init(sim, &config, out);
+    sim->trace = sweep->trace;
+    sim->format = sweep->format;
+    int status = run_simulation(sim, job->quantum, job->strategy);
+    sim_destroy(sim);
+    free(sim);
+
+    if (close(out) != 0) {
+        fprintf(stderr, "Failed to write file %s\n", path);
+        return -1;
+    }
+    return status;
+}
+
+// Workers pull the next job until none are left
+static void* sweep_worker(void *arg) {
+    sweep_t *sweep = arg;
+    for (;;) {
+        int i = atomic_fetch_add(&sweep->next_job, 1);
+        if (i >= sweep->num_jobs) break;
+        if (run_job(sweep, &sweep->jobs[i]) != 0) {
+            atomic_store(&sweep->failed, 1);
+        }
+    }
+    return NULL;
+}
+
+int run_sweep(const trace_t *trace, const sim_config_t *config, const char *out_dir,
+              const int *quanta, int num_quanta, char **strategies, int num_strategies,
+              const replacement_policy_t *policies, int num_policies,
+              const scheduler_t *schedulers, int num_schedulers,
+              event_format_t format, int threads) {
+    if (mkdir(out_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create directory %s\n", out_dir);
+        return -1;
+    }
+
+    sweep_t sweep;
+    sweep.trace = trace;
+    sweep.config = config;
+    sweep.out_dir = out_dir;
+    sweep.format = format;
+    sweep.name_policy = num_policies > 1;
+    sweep.name_scheduler = num_schedulers > 1;
+    sweep.num_jobs = num_quanta * num_strategies * num_policies * num_schedulers;
+    sweep.jobs = malloc(sweep.num_jobs * sizeof(sweep_job_t));
+    if (!sweep.jobs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    sweep_job_t *job = sweep.jobs;
+    for (int s = 0; s < num_strategies; s++) {
+        for (int p = 0; p < num_policies; p++) {
+            for (int c = 0; c < num_schedulers; c++) {
+                for (int q = 0; q < num_quanta; q++, job++) {
+                    job->strategy = strategies[s];
+                    job->policy = policies[p];
+                    job->scheduler = schedulers[c];
+                    job->quantum = quanta[q];
+                }
+            }
+        }
+    }
+    atomic_init(&sweep.next_job, 0);
+    atomic_init(&sweep.failed, 0);
+
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > sweep.num_jobs) {
+        threads = sweep.num_jobs;
+    }
+
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    if (!workers) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, sweep_worker, &sweep) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {
+        sweep_worker(&sweep);  // no threads to be had; run the jobs here
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+    free(sweep.jobs);
+    return atomic_load(&sweep.failed) ? -1 : 0;
+}
@@ -0,0 +1,19 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "memory_management.h"
+
+#define SWEEP_MAX_ITEMS 64  // most quanta or strategies one sweep takes
+
+// Simulate every (strategy, policy, scheduler, quantum) combination over trace
+// on a pool of threads, writing each event log to
+// <out_dir>/<strategy>[-<policy>][-<scheduler>]-q<quantum>.<txt|csv|bin>, where
+// the policy and scheduler are named only when more than one is given.
+// threads <= 0 uses one thread per online CPU.
+int run_sweep(const trace_t *trace, const sim_config_t *config, const char *out_dir,
+              const int *quanta, int num_quanta, char **strategies, int num_strategies,
+              const replacement_policy_t *policies, int num_policies,
+              const scheduler_t *schedulers, int num_schedulers,
+              event_format_t format, int threads);
+
+#endif // SWEEP_H
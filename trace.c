@@ -0,0 +1,573 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+// Whole file contents, mapped when possible and read otherwise (pipes, /dev/stdin)
+typedef struct {
+    char *data;
+    size_t size;
+    int mapped;
+} file_view_t;
+
+static int open_view(file_view_t *view, const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    view->data = NULL;
+    view->size = 0;
+    view->mapped = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        view->size = st.st_size;
+        if (view->size == 0) {
+            close(fd);
+            return 0;
+        }
+        void *p = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, view->size, MADV_SEQUENTIAL);
+            view->data = p;
+            view->mapped = 1;
+            close(fd);
+            return 0;
+        }
+    }
+
+    size_t capacity = 1 << 16;
+    view->size = 0;
+    view->data = malloc(capacity);
+    for (;;) {
+        if (!view->data) {
+            close(fd);
+            return -1;
+        }
+        ssize_t n = read(fd, view->data + view->size, capacity - view->size);
+        if (n < 0) {
+            free(view->data);
+            close(fd);
+            return -1;
+        }
+        if (n == 0) break;
+        view->size += n;
+        if (view->size == capacity) {
+            capacity *= 2;
+            char *grown = realloc(view->data, capacity);
+            if (!grown) free(view->data);
+            view->data = grown;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+static void close_view(file_view_t *view) {
+    if (view->mapped) {
+        munmap(view->data, view->size);
+    } else {
+        free(view->data);
+    }
+}
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Decimal integer at *p, without locale or errno; 0 when there is none or it overflows
+static int parse_int(const char **p, const char *end, int *out) {
+    const char *s = *p;
+    int negative = 0;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        s++;
+    }
+    const char *digits = s;
+    long long value = 0;
+    while (s < end && (unsigned)(*s - '0') < 10) {
+        value = value * 10 + (*s - '0');
+        if (value > (long long)INT_MAX + negative) return 0;
+        s++;
+    }
+    if (s == digits) return 0;
+    *out = negative ? (int)-value : (int)value;
+    *p = s;
+    return 1;
+}
+
+static int push_record(void *ctx, const process_record_t *record) {
+    trace_t *trace = ctx;
+    if (trace->count == trace->capacity) {
+        long capacity = trace->capacity ? trace->capacity * 2 : 1024;
+        process_record_t *grown = realloc(trace->records, capacity * sizeof(process_record_t));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return -1;
+        }
+        trace->records = grown;
+        trace->capacity = capacity;
+    }
+    trace->records[trace->count++] = *record;
+    return 0;
+}
+
+static int bad_line(const char *filename, long line, const char *what) {
+    fprintf(stderr, "%s:%ld: %s\n", filename, line, what);
+    return -1;
+}
+
+// Parses every line of the text trace filename and hands each record to
+// emit, stopping early if emit returns non-zero. Blank lines are skipped;
+// any other line must hold exactly four fields: an arrival time of 0 or
+// more, a name, a positive run time and a memory size of 0 or more.
+// Returns 0, or -1 after printing the file and line of the first problem.
+int scan_trace(const char *filename, record_sink_t emit, void *ctx) {
+    file_view_t view;
+    if (open_view(&view, filename) != 0) {
+        fprintf(stderr, "Failed to open file\n");
+        return -1;
+    }
+
+    const char *p = view.data, *end = view.data + view.size;
+    long line = 0;
+    int status = 0;
+    while (p < end && status == 0) {
+        line++;
+        const char *eol = memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+
+        while (p < eol && is_blank(*p)) p++;
+        if (p == eol) {
+            p = eol + 1;
+            continue;
+        }
+
+        process_record_t record;
+        if (!parse_int(&p, eol, &record.arr_time)) {
+            status = bad_line(filename, line, "expected an arrival time");
+            break;
+        }
+        if (record.arr_time < 0) {
+            status = bad_line(filename, line, "arrival time is negative");
+            break;
+        }
+        while (p < eol && is_blank(*p)) p++;
+        const char *pid = p;
+        while (p < eol && !is_blank(*p)) p++;
+        if (p == pid) {
+            status = bad_line(filename, line, "expected a process name");
+            break;
+        }
+        if (p - pid > MAX_LEN) {
+            status = bad_line(filename, line, "process name is longer than " TO_STRING(MAX_LEN) " characters");
+            break;
+        }
+        memcpy(record.pid, pid, p - pid);
+        record.pid[p - pid] = '\0';
+        while (p < eol && is_blank(*p)) p++;
+        if (!parse_int(&p, eol, &record.run_time)) {
+            status = bad_line(filename, line, "expected a run time");
+            break;
+        }
+        if (record.run_time <= 0) {
+            status = bad_line(filename, line, "run time is not positive");
+            break;
+        }
+        while (p < eol && is_blank(*p)) p++;
+        if (!parse_int(&p, eol, &record.memory)) {
+            status = bad_line(filename, line, "expected a memory size");
+            break;
+        }
+        if (record.memory < 0) {
+            status = bad_line(filename, line, "memory size is negative");
+            break;
+        }
+        while (p < eol && is_blank(*p)) p++;
+        if (p != eol) {
+            status = bad_line(filename, line, "unexpected text after the memory size");
+            break;
+        }
+        status = emit(ctx, &record);
+        p = eol + 1;
+    }
+
+    close_view(&view);
+    return status;
+}
+
+// Streams the records of the binary trace filename to emit, in trace order
+static int scan_binary_trace(const char *filename, record_sink_t emit, void *ctx) {
+    trace_stream_t stream;
+    if (trace_stream_open(&stream, filename, TRACE_CHUNK_RECORDS) != 0) {
+        return -1;
+    }
+    process_record_t record;
+    int status = 0;
+    int more;
+    while (status == 0 && (more = trace_stream_next(&stream, &record)) != 0) {
+        status = more < 0 ? -1 : emit(ctx, &record);
+    }
+    trace_stream_close(&stream);
+    return status;
+}
+
+// Reads a whole trace, text or binary, into memory
+int load_trace(trace_t *trace, const char *filename) {
+    trace->records = NULL;
+    trace->count = 0;
+    trace->capacity = 0;
+
+    int status = is_binary_trace(filename) ? scan_binary_trace(filename, push_record, trace)
+                                           : scan_trace(filename, push_record, trace);
+    if (status != 0) {
+        free_trace(trace);
+    }
+    return status;
+}
+
+void free_trace(trace_t *trace) {
+    free(trace->records);
+    trace->records = NULL;
+    trace->count = 0;
+    trace->capacity = 0;
+}
+
+// Page access traces are text, one "<pid> <page> <page> ..." line per run
+// of accesses. Lines naming the same process add to its list in file order.
+
+static int compare_access_lists(const void *a, const void *b) {
+    const access_list_t *x = a, *y = b;
+    int order = strcmp(x->pid, y->pid);
+    if (order != 0) return order;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+static int compare_pid_to_list(const void *key, const void *list) {
+    return strcmp(key, ((const access_list_t *)list)->pid);
+}
+
+// Grows *array of *capacity elements of size bytes to hold one more
+static int make_room(void **array, long *capacity, long count, size_t size) {
+    if (count < *capacity) return 0;
+    long grown_capacity = *capacity ? *capacity * 2 : 1024;
+    void *grown = realloc(*array, grown_capacity * size);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    *array = grown;
+    *capacity = grown_capacity;
+    return 0;
+}
+
+// Reads a page access trace into one array of pages with one list per
+// process. Returns 0, or -1 after printing the file and line of the first
+// problem.
+int load_access_trace(access_trace_t *trace, const char *filename) {
+    trace->lists = NULL;
+    trace->list_count = 0;
+    trace->pages = NULL;
+    trace->count = 0;
+
+    file_view_t view;
+    if (open_view(&view, filename) != 0) {
+        fprintf(stderr, "Failed to open file\n");
+        return -1;
+    }
+
+    // One list per line at first, pointing into pages in file order
+    access_list_t *lines = NULL;
+    long line_count = 0, line_capacity = 0;
+    int *pages = NULL;
+    long count = 0, capacity = 0;
+    const char *p = view.data, *end = view.data + view.size;
+    long line = 0;
+    int status = 0;
+    while (p < end && status == 0) {
+        line++;
+        const char *eol = memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+
+        while (p < eol && is_blank(*p)) p++;
+        if (p == eol) {
+            p = eol + 1;
+            continue;
+        }
+        const char *pid = p;
+        while (p < eol && !is_blank(*p)) p++;
+        if (p - pid > MAX_LEN) {
+            status = bad_line(filename, line, "process name is longer than " TO_STRING(MAX_LEN) " characters");
+            break;
+        }
+        if (make_room((void **)&lines, &line_capacity, line_count, sizeof(access_list_t)) != 0) {
+            status = -1;
+            break;
+        }
+        access_list_t *list = &lines[line_count++];
+        memcpy(list->pid, pid, p - pid);
+        list->pid[p - pid] = '\0';
+        list->start = count;
+        for (;;) {
+            while (p < eol && is_blank(*p)) p++;
+            if (p == eol) break;
+            int page;
+            if (!parse_int(&p, eol, &page) || page < 0 || (p < eol && !is_blank(*p))) {
+                status = bad_line(filename, line, "expected a page number");
+                break;
+            }
+            if (make_room((void **)&pages, &capacity, count, sizeof(int)) != 0) {
+                status = -1;
+                break;
+            }
+            pages[count++] = page;
+        }
+        list->count = count - list->start;
+        p = eol + 1;
+    }
+    close_view(&view);
+    if (status != 0) {
+        free(lines);
+        free(pages);
+        return -1;
+    }
+
+    // Group the lines by process. When each process's lines already follow
+    // one another the pages stay where they are; otherwise they are copied
+    // into process order.
+    qsort(lines, line_count, sizeof(access_list_t), compare_access_lists);
+    int in_place = 1;
+    for (long i = 0, at = 0; i < line_count && in_place; at += lines[i].count, i++) {
+        in_place = lines[i].start == at;
+    }
+    int *grouped = pages;
+    if (!in_place) {
+        grouped = malloc((count ? count : 1) * sizeof(int));
+        if (!grouped) {
+            fprintf(stderr, "Memory allocation failed\n");
+            free(lines);
+            free(pages);
+            return -1;
+        }
+    }
+    long merged = 0, at = 0;
+    for (long i = 0; i < line_count; i++) {
+        long start = lines[i].start, pages_in_line = lines[i].count;
+        if (merged == 0 || strcmp(lines[merged - 1].pid, lines[i].pid) != 0) {
+            lines[merged] = lines[i];
+            lines[merged].start = at;
+            lines[merged].count = 0;
+            merged++;
+        }
+        if (!in_place) {
+            memcpy(grouped + at, pages + start, pages_in_line * sizeof(int));
+        }
+        lines[merged - 1].count += pages_in_line;
+        at += pages_in_line;
+    }
+    if (!in_place) {
+        free(pages);
+    }
+    trace->lists = lines;
+    trace->list_count = merged;
+    trace->pages = grouped;
+    trace->count = count;
+    return 0;
+}
+
+void free_access_trace(access_trace_t *trace) {
+    free(trace->lists);
+    free(trace->pages);
+    trace->lists = NULL;
+    trace->pages = NULL;
+    trace->list_count = 0;
+    trace->count = 0;
+}
+
+// Accesses of the process named pid, or NULL when the trace has none
+const access_list_t* find_access_list(const access_trace_t *trace, const char *pid) {
+    if (trace->list_count == 0) return NULL;
+    return bsearch(pid, trace->lists, trace->list_count, sizeof(access_list_t), compare_pid_to_list);
+}
+
+// Binary traces: a TRACE_HEADER_SIZE header (magic, version, record size,
+// record count) followed by fixed TRACE_RECORD_SIZE records, all little-endian.
+
+static void put_u16(unsigned char *p, unsigned v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (8 * i)) & 0xff;
+    }
+}
+
+static unsigned get_u16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void encode_header(unsigned char *h, uint64_t count) {
+    memcpy(h, TRACE_MAGIC, 4);
+    put_u16(h + 4, TRACE_VERSION);
+    put_u16(h + 6, TRACE_RECORD_SIZE);
+    put_u32(h + 8, (uint32_t)count);
+    put_u32(h + 12, (uint32_t)(count >> 32));
+}
+
+static void encode_record(unsigned char *r, const process_record_t *record) {
+    put_u32(r, (uint32_t)record->arr_time);
+    put_u32(r + 4, (uint32_t)record->run_time);
+    put_u32(r + 8, (uint32_t)record->memory);
+    memset(r + 12, 0, MAX_LEN);
+    memcpy(r + 12, record->pid, strlen(record->pid));
+}
+
+static void decode_record(const unsigned char *r, process_record_t *record) {
+    record->arr_time = (int32_t)get_u32(r);
+    record->run_time = (int32_t)get_u32(r + 4);
+    record->memory = (int32_t)get_u32(r + 8);
+    memcpy(record->pid, r + 12, MAX_LEN);
+    record->pid[MAX_LEN] = '\0';
+}
+
+int is_binary_trace(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;
+    char magic[4];
+    int binary = read(fd, magic, 4) == 4 && memcmp(magic, TRACE_MAGIC, 4) == 0;
+    close(fd);
+    return binary;
+}
+
+int trace_writer_open(trace_writer_t *writer, const char *filename) {
+    writer->fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "wb");
+    writer->count = 0;
+    if (!writer->fp) {
+        fprintf(stderr, "Failed to open %s for writing\n", filename);
+        return -1;
+    }
+    unsigned char header[TRACE_HEADER_SIZE];
+    encode_header(header, 0);  // count filled in on close when the output is seekable
+    return fwrite(header, sizeof(header), 1, writer->fp) == 1 ? 0 : -1;
+}
+
+int trace_writer_put(void *ctx, const process_record_t *record) {
+    trace_writer_t *writer = ctx;
+    unsigned char r[TRACE_RECORD_SIZE];
+    encode_record(r, record);
+    if (fwrite(r, sizeof(r), 1, writer->fp) != 1) {
+        fprintf(stderr, "Failed to write binary trace\n");
+        return -1;
+    }
+    writer->count++;
+    return 0;
+}
+
+int trace_writer_close(trace_writer_t *writer) {
+    int status = 0;
+    unsigned char header[TRACE_HEADER_SIZE];
+    encode_header(header, writer->count);
+    if (fseek(writer->fp, 0, SEEK_SET) == 0) {
+        status = fwrite(header, sizeof(header), 1, writer->fp) == 1 ? 0 : -1;
+    }
+    if (writer->fp != stdout) {
+        status |= fclose(writer->fp);
+    } else {
+        status |= fflush(writer->fp);
+    }
+    return status;
+}
+
+int trace_stream_open(trace_stream_t *stream, const char *filename, int chunk_records) {
+    stream->filename = filename;
+    stream->fd = open(filename, O_RDONLY);
+    if (stream->fd < 0) {
+        fprintf(stderr, "Failed to open file\n");
+        return -1;
+    }
+    unsigned char header[TRACE_HEADER_SIZE];
+    if (read(stream->fd, header, sizeof(header)) != (ssize_t)sizeof(header) ||
+            memcmp(header, TRACE_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: not a binary trace\n", filename);
+        close(stream->fd);
+        return -1;
+    }
+    if (get_u16(header + 4) != TRACE_VERSION || get_u16(header + 6) != TRACE_RECORD_SIZE) {
+        fprintf(stderr, "%s: unsupported binary trace version %u\n", filename, get_u16(header + 4));
+        close(stream->fd);
+        return -1;
+    }
+    stream->remaining = get_u32(header + 8) | ((uint64_t)get_u32(header + 12) << 32);
+    stream->unbounded = stream->remaining == 0;  // written to a pipe: read to end of file
+    stream->chunk_records = chunk_records > 0 ? chunk_records : TRACE_CHUNK_RECORDS;
+    stream->buffer = malloc((size_t)stream->chunk_records * TRACE_RECORD_SIZE);
+    if (!stream->buffer) {
+        fprintf(stderr, "Memory allocation failed\n");
+        close(stream->fd);
+        return -1;
+    }
+    stream->filled = 0;
+    stream->pos = 0;
+    return 0;
+}
+
+// Pulls the next chunk of records into the buffer; returns how many
+// arrived, or -1 when the file is shorter than it should be or unreadable
+static int refill_stream(trace_stream_t *stream) {
+    size_t want = (size_t)stream->chunk_records * TRACE_RECORD_SIZE;
+    if (!stream->unbounded && stream->remaining < (uint64_t)stream->chunk_records) {
+        want = stream->remaining * TRACE_RECORD_SIZE;
+    }
+    size_t got = 0;
+    while (got < want) {
+        ssize_t n = read(stream->fd, stream->buffer + got, want - got);
+        if (n < 0) {
+            fprintf(stderr, "%s: failed to read binary trace\n", stream->filename);
+            return -1;
+        }
+        if (n == 0) break;
+        got += n;
+    }
+    // The header promised more records, or the file ends inside one
+    if ((!stream->unbounded && got < want) || got % TRACE_RECORD_SIZE != 0) {
+        fprintf(stderr, "%s: truncated binary trace\n", stream->filename);
+        return -1;
+    }
+    stream->filled = got / TRACE_RECORD_SIZE;
+    stream->pos = 0;
+    if (!stream->unbounded) {
+        stream->remaining -= stream->filled;
+    }
+    return stream->filled;
+}
+
+// 1 with the next record, 0 at the end of the trace, -1 when it is truncated
+int trace_stream_next(trace_stream_t *stream, process_record_t *record) {
+    if (stream->pos == stream->filled) {
+        int arrived = refill_stream(stream);
+        if (arrived <= 0) return arrived;
+    }
+    decode_record(stream->buffer + (size_t)stream->pos++ * TRACE_RECORD_SIZE, record);
+    return 1;
+}
+
+void trace_stream_close(trace_stream_t *stream) {
+    free(stream->buffer);
+    close(stream->fd);
+}
@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define MAX_LEN 8  // Longest process name in a trace
+
+#define TRACE_MAGIC "RRTB"  // first bytes of a binary trace
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE (12 + MAX_LEN)  // arrival, run time, memory, pid
+#define TRACE_CHUNK_RECORDS 4096  // records a stream reads at a time
+
+// One line of a workload trace: "<arrival> <pid> <run time> <memory KB>"
+typedef struct {
+    int arr_time;
+    int run_time;
+    int memory;
+    char pid[MAX_LEN + 1];
+} process_record_t;
+
+// Every record of a trace file, in file order, in one contiguous array
+typedef struct {
+    process_record_t *records;
+    long count;
+    long capacity;
+} trace_t;
+
+// Receives parsed records; a non-zero return stops the scan
+typedef int (*record_sink_t)(void *ctx, const process_record_t *record);
+
+// Appends records to a binary trace
+typedef struct {
+    FILE *fp;
+    uint64_t count;
+} trace_writer_t;
+
+// Reads a binary trace a chunk at a time, so only chunk_records are held
+typedef struct {
+    const char *filename;
+    int fd;
+    unsigned char *buffer;
+    int chunk_records;
+    int filled;  // records in the buffer
+    int pos;  // next record in the buffer
+    uint64_t remaining;  // records left in the file past the buffer
+    int unbounded;  // header carries no count; read until end of file
+} trace_stream_t;
+
+// Pages one process touches, in order: pages[start .. start + count)
+typedef struct {
+    char pid[MAX_LEN + 1];
+    long start;
+    long count;
+} access_list_t;
+
+// Page access trace, one access list per process name sorted by name
+typedef struct {
+    access_list_t *lists;
+    long list_count;
+    int *pages;
+    long count;
+} access_trace_t;
+
+int scan_trace(const char *filename, record_sink_t emit, void *ctx);
+int load_trace(trace_t *trace, const char *filename);
+void free_trace(trace_t *trace);
+int load_access_trace(access_trace_t *trace, const char *filename);
+void free_access_trace(access_trace_t *trace);
+const access_list_t* find_access_list(const access_trace_t *trace, const char *pid);
+
+int is_binary_trace(const char *filename);
+int trace_writer_open(trace_writer_t *writer, const char *filename);
+int trace_writer_put(void *ctx, const process_record_t *record);
+int trace_writer_close(trace_writer_t *writer);
+int trace_stream_open(trace_stream_t *stream, const char *filename, int chunk_records);
+int trace_stream_next(trace_stream_t *stream, process_record_t *record);
+void trace_stream_close(trace_stream_t *stream);
+
+#endif // TRACE_H
@@ -0,0 +1,23 @@
+
+#include <stdio.h>
+#include "trace.h"
+
+// Converts a text trace into the binary trace format read by allocate.
+// Usage: trace_convert <text trace> <binary trace, or - for stdout>
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <text trace> <binary trace>\n", argv[0]);
+        return 1;
+    }
+
+    trace_writer_t writer;
+    if (trace_writer_open(&writer, argv[2]) != 0) {
+        return 1;
+    }
+    int status = scan_trace(argv[1], trace_writer_put, &writer);
+    if (trace_writer_close(&writer) != 0) {
+        fprintf(stderr, "Failed to write binary trace\n");
+        status = -1;
+    }
+    return status == 0 ? 0 : 1;
+}